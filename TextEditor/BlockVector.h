@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Sequence container with a vector-like interface, stored as a list of small
+// blocks plus a table of where each block starts. Indexing is a binary search
+// over the block table (or O(1) when it hits the block used last), and an
+// insert or erase only shifts items inside one block and the start offsets
+// after it, so editing near the top of a million-line document does not move
+// every line below it. References stay valid until the next insert or erase.
+template<typename T, size_t BlockSize = 512>
+class BlockVector
+{
+public:
+	template<bool IsConst>
+	class Iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef typename std::conditional<IsConst, const T*, T*>::type pointer;
+		typedef typename std::conditional<IsConst, const T&, T&>::type reference;
+		typedef typename std::conditional<IsConst, const BlockVector*, BlockVector*>::type Owner;
+
+		Iterator() : mOwner(nullptr), mBlock(0), mItem(0) {}
+		Iterator(Owner aOwner, size_t aBlock, size_t aItem) : mOwner(aOwner), mBlock(aBlock), mItem(aItem) {}
+
+		reference operator*() const { return mOwner->mBlocks[mBlock][mItem]; }
+		pointer operator->() const { return &mOwner->mBlocks[mBlock][mItem]; }
+
+		Iterator& operator++()
+		{
+			if (++mItem == mOwner->mBlocks[mBlock].size())
+			{
+				++mBlock;
+				mItem = 0;
+			}
+			return *this;
+		}
+
+		Iterator operator++(int) { Iterator tmp = *this; ++*this; return tmp; }
+
+		bool operator==(const Iterator& o) const { return mBlock == o.mBlock && mItem == o.mItem; }
+		bool operator!=(const Iterator& o) const { return !(*this == o); }
+
+	private:
+		Owner mOwner;
+		size_t mBlock;
+		size_t mItem;
+	};
+
+	typedef T value_type;
+	typedef Iterator<false> iterator;
+	typedef Iterator<true> const_iterator;
+
+	BlockVector() : mSize(0), mLastBlock(0) {}
+
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+
+	T& operator[](size_t aIndex)
+	{
+		auto block = FindBlock(aIndex);
+		return mBlocks[block][aIndex - mStarts[block]];
+	}
+
+	const T& operator[](size_t aIndex) const
+	{
+		auto block = FindBlock(aIndex);
+		return mBlocks[block][aIndex - mStarts[block]];
+	}
+
+	T& at(size_t aIndex) { assert(aIndex < mSize); return (*this)[aIndex]; }
+	const T& at(size_t aIndex) const { assert(aIndex < mSize); return (*this)[aIndex]; }
+
+	T& front() { return mBlocks.front().front(); }
+	const T& front() const { return mBlocks.front().front(); }
+	T& back() { return mBlocks.back().back(); }
+	const T& back() const { return mBlocks.back().back(); }
+
+	iterator begin() { return iterator(this, 0, 0); }
+	iterator end() { return iterator(this, mBlocks.size(), 0); }
+	const_iterator begin() const { return const_iterator(this, 0, 0); }
+	const_iterator end() const { return const_iterator(this, mBlocks.size(), 0); }
+
+	void clear()
+	{
+		mBlocks.clear();
+		mStarts.clear();
+		mSize = 0;
+		mLastBlock = 0;
+	}
+
+	void push_back(T aValue)
+	{
+		emplace_back(std::move(aValue));
+	}
+
+	template<typename... Args>
+	T& emplace_back(Args&&... aArgs)
+	{
+		if (mBlocks.empty() || mBlocks.back().size() >= BlockSize)
+		{
+			mBlocks.emplace_back();
+			mBlocks.back().reserve(BlockSize);
+			mStarts.push_back(mSize);
+		}
+		++mSize;
+		return mBlocks.back().emplace_back(std::forward<Args>(aArgs)...);
+	}
+
+	void resize(size_t aSize)
+	{
+		if (aSize < mSize)
+			erase(aSize, mSize);
+		while (mSize < aSize)
+			emplace_back();
+	}
+
+	// Inserts one item before aIndex and returns it
+	T& insert(size_t aIndex, T aValue)
+	{
+		assert(aIndex <= mSize);
+		if (aIndex == mSize)
+			return emplace_back(std::move(aValue));
+
+		auto block = FindBlock(aIndex);
+		auto& items = mBlocks[block];
+		auto offset = aIndex - mStarts[block];
+		items.insert(items.begin() + offset, std::move(aValue));
+		++mSize;
+
+		if (items.size() > 2 * BlockSize)
+		{
+			SplitBlock(block, BlockSize);
+			if (offset >= BlockSize)
+			{
+				++block;
+				offset -= BlockSize;
+			}
+		}
+		UpdateStarts(block);
+		return mBlocks[block][offset];
+	}
+
+	// Inserts every item of aValues before aIndex. Large batches become
+	// blocks of their own, so the cost is O(BlockSize + n / BlockSize)
+	// on top of moving the new items in.
+	void insert(size_t aIndex, std::vector<T>&& aValues)
+	{
+		assert(aIndex <= mSize);
+		if (aValues.empty())
+			return;
+
+		if (aValues.size() <= BlockSize && aIndex < mSize)
+		{
+			auto block = FindBlock(aIndex);
+			auto& items = mBlocks[block];
+			auto offset = aIndex - mStarts[block];
+			items.insert(items.begin() + offset, std::make_move_iterator(aValues.begin()), std::make_move_iterator(aValues.end()));
+			mSize += aValues.size();
+			if (items.size() > 2 * BlockSize)
+				SplitBlock(block, items.size() / 2);
+			UpdateStarts(block);
+			return;
+		}
+
+		// Cut the block at aIndex so the new blocks can be spliced in between
+		size_t at = mBlocks.size();
+		if (aIndex < mSize)
+		{
+			at = FindBlock(aIndex);
+			auto offset = aIndex - mStarts[at];
+			if (offset > 0)
+			{
+				SplitBlock(at, offset);
+				++at;
+			}
+		}
+
+		std::vector<std::vector<T>> blocks;
+		blocks.reserve((aValues.size() + BlockSize - 1) / BlockSize);
+		for (size_t i = 0; i < aValues.size(); i += BlockSize)
+		{
+			auto last = std::min(aValues.size(), i + BlockSize);
+			blocks.emplace_back(std::make_move_iterator(aValues.begin() + i), std::make_move_iterator(aValues.begin() + last));
+		}
+
+		mSize += aValues.size();
+		mBlocks.insert(mBlocks.begin() + at, std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+		mStarts.resize(mBlocks.size());
+		UpdateStarts(at);
+	}
+
+	// Removes the items in [aFirst, aLast)
+	void erase(size_t aFirst, size_t aLast)
+	{
+		assert(aFirst <= aLast && aLast <= mSize);
+		if (aFirst == aLast)
+			return;
+
+		auto first = FindBlock(aFirst);
+		auto last = FindBlock(aLast - 1);
+		auto firstOffset = aFirst - mStarts[first];
+		auto lastOffset = aLast - mStarts[last];
+
+		if (first == last)
+		{
+			auto& items = mBlocks[first];
+			items.erase(items.begin() + firstOffset, items.begin() + lastOffset);
+		}
+		else
+		{
+			auto& head = mBlocks[first];
+			auto& tail = mBlocks[last];
+			head.erase(head.begin() + firstOffset, head.end());
+			tail.erase(tail.begin(), tail.begin() + lastOffset);
+			mBlocks.erase(mBlocks.begin() + first + 1, mBlocks.begin() + last);
+			mStarts.erase(mStarts.begin() + first + 1, mStarts.begin() + last);
+		}
+		mSize -= aLast - aFirst;
+
+		// Drop emptied blocks and fold a small remainder into its neighbour
+		for (auto i = std::min(first + 2, mBlocks.size()); i-- > first; )
+		{
+			if (mBlocks[i].empty())
+			{
+				mBlocks.erase(mBlocks.begin() + i);
+				mStarts.erase(mStarts.begin() + i);
+			}
+		}
+		if (first < mBlocks.size() && first + 1 < mBlocks.size()
+			&& mBlocks[first].size() + mBlocks[first + 1].size() <= BlockSize)
+		{
+			auto& next = mBlocks[first + 1];
+			mBlocks[first].insert(mBlocks[first].end(), std::make_move_iterator(next.begin()), std::make_move_iterator(next.end()));
+			mBlocks.erase(mBlocks.begin() + first + 1);
+			mStarts.erase(mStarts.begin() + first + 1);
+		}
+
+		mLastBlock = 0;
+		UpdateStarts(first);
+	}
+
+	void erase(size_t aIndex)
+	{
+		erase(aIndex, aIndex + 1);
+	}
+
+private:
+	size_t FindBlock(size_t aIndex) const
+	{
+		assert(aIndex < mSize);
+		if (mLastBlock < mBlocks.size() && aIndex >= mStarts[mLastBlock]
+			&& aIndex - mStarts[mLastBlock] < mBlocks[mLastBlock].size())
+			return mLastBlock;
+
+		auto it = std::upper_bound(mStarts.begin(), mStarts.end(), aIndex);
+		mLastBlock = (size_t)(it - mStarts.begin()) - 1;
+		return mLastBlock;
+	}
+
+	// Moves the items of aBlock from aOffset onwards into a new block after it
+	void SplitBlock(size_t aBlock, size_t aOffset)
+	{
+		auto& items = mBlocks[aBlock];
+		std::vector<T> tail(std::make_move_iterator(items.begin() + aOffset), std::make_move_iterator(items.end()));
+		items.erase(items.begin() + aOffset, items.end());
+		mBlocks.insert(mBlocks.begin() + aBlock + 1, std::move(tail));
+		mStarts.insert(mStarts.begin() + aBlock + 1, 0);
+	}
+
+	void UpdateStarts(size_t aFrom)
+	{
+		size_t start = aFrom == 0 ? 0 : mStarts[aFrom - 1] + mBlocks[aFrom - 1].size();
+		for (size_t i = aFrom; i < mBlocks.size(); ++i)
+		{
+			mStarts[i] = start;
+			start += mBlocks[i].size();
+		}
+	}
+
+	std::vector<std::vector<T>> mBlocks;
+	std::vector<size_t> mStarts;
+	size_t mSize;
+	mutable size_t mLastBlock;
+};
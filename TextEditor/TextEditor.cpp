@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <string>
 #include <regex>
 #include <cmath>
@@ -26,6 +27,8 @@ bool equals(InputIt1 first1, InputIt1 last1,
 TextEditor::TextEditor()
 	: mLineSpacing(1.0f)
 	, mUndoIndex(0)
+	, mUndoMemory(0)
+	, mUndoMemoryLimit(kDefaultUndoMemoryLimit)
 	, mTabSize(4)
 	, mOverwrite(false)
 	, mReadOnly(false)
@@ -37,10 +40,26 @@ TextEditor::TextEditor()
 	, mTextStart(20.0f)
 	, mLeftMargin(10)
 	, mCursorPositionChanged(false)
-	, mColorRangeMin(0)
-	, mColorRangeMax(0)
+	, mFirstVisibleLine(0)
+	, mLastVisibleLine(0)
 	, mSelectionMode(SelectionMode::Normal)
-	, mCheckComments(true)
+	, mCommentScanMin(0)
+	, mCommentScanMax(0)
+	, mMeasureMin(0)
+	, mMeasureMax(0)
+	, mSearchMin(std::numeric_limits<int>::max())
+	, mSearchMax(0)
+	, mSearchMatchCount(0)
+	, mSearchSkippedLines(0)
+	, mScrollKeepFocus(false)
+	, mLastStamp(0)
+	, mRenderFrame(0)
+	, mRevision(0)
+	, mColorizeCancel(false)
+	, mColorizeQuit(false)
+	, mColorizeBusy(false)
+	, mColorizeJobMin(0)
+	, mColorizeJobMax(0)
 	, mLastClick(-1.0f)
 	, mHandleKeyboardInputs(true)
 	, mHandleMouseInputs(true)
@@ -55,15 +74,35 @@ TextEditor::TextEditor()
 
 TextEditor::~TextEditor()
 {
+	{
+		std::lock_guard<std::mutex> lock(mColorizeMutex);
+		mColorizeQuit = true;
+		mColorizeCancel = true;
+	}
+	mColorizeCondition.notify_all();
+
+	if (mColorizeThread.joinable())
+		mColorizeThread.join();
 }
 
 void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
 {
+	// The colorizer thread reads the language while it works
+	CancelColorizeJob();
+
 	mLanguageDefinition = aLanguageDef;
 	mRegexList.clear();
 
+	// Prefer the compiled automaton, std::regex only covers patterns it can't take
+	std::vector<std::string> patterns;
 	for (auto& r : mLanguageDefinition.mTokenRegexStrings)
-		mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+		patterns.push_back(r.first);
+
+	if (!mTokenDFA.Compile(patterns))
+	{
+		for (auto& r : mLanguageDefinition.mTokenRegexStrings)
+			mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+	}
 
 	Colorize();
 }
@@ -75,38 +114,42 @@ void TextEditor::SetPalette(const Palette & aValue)
 
 std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
 {
-	std::string result;
-
-	auto lstart = aStart.mLine;
-	auto lend = aEnd.mLine;
-	auto istart = GetCharacterIndex(aStart);
-	auto iend = GetCharacterIndex(aEnd);
-	size_t s = 0;
-
-	for (size_t i = lstart; i < lend; i++)
-		s += mLines[i].size();
-
-	result.reserve(s + s / 8);
-
-	while (istart < iend || lstart < lend)
+	// Walks the range as runs of line bytes and newlines, first to size the
+	// result exactly and then to fill it
+	auto forEachRun = [&](auto&& aRun)
 	{
-		if (lstart >= (int)mLines.size())
-			break;
+		auto lstart = aStart.mLine;
+		auto lend = aEnd.mLine;
+		auto istart = GetCharacterIndex(aStart);
+		auto iend = GetCharacterIndex(aEnd);
 
-		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
-		{
-			result += line[istart].mChar;
-			istart++;
-		}
-		else
+		while (istart < iend || lstart < lend)
 		{
-			istart = 0;
-			++lstart;
-			result += '\n';
+			if (lstart >= (int)mLines.size())
+				break;
+
+			auto& line = mLines[lstart];
+			if (istart < (int)line.size())
+			{
+				auto stop = lstart < lend ? (int)line.size() : std::min(iend, (int)line.size());
+				aRun(line.mText.data() + istart, (size_t)(stop - istart));
+				istart = stop;
+			}
+			else
+			{
+				istart = 0;
+				++lstart;
+				aRun("\n", 1);
+			}
 		}
-	}
+	};
 
+	size_t size = 0;
+	forEachRun([&](const char*, size_t aSize) { size += aSize; });
+
+	std::string result;
+	result.reserve(size);
+	forEachRun([&](const char* aData, size_t aSize) { result.append(aData, aSize); });
 	return result;
 }
 
@@ -204,7 +247,7 @@ void TextEditor::Advance(Coordinates & aCoordinates) const
 
 		if (cindex + 1 < (int)line.size())
 		{
-			auto delta = UTF8CharLength(line[cindex].mChar);
+			auto delta = UTF8CharLength(line.GetChar(cindex));
 			cindex = std::min(cindex + delta, (int)line.size() - 1);
 		}
 		else
@@ -234,20 +277,20 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 		auto& line = mLines[aStart.mLine];
 		auto n = GetLineMaxColumn(aStart.mLine);
 		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
+			line.Erase(start, line.size());
 		else
-			line.erase(line.begin() + start, line.begin() + end);
+			line.Erase(start, end);
 	}
 	else
 	{
 		auto& firstLine = mLines[aStart.mLine];
 		auto& lastLine = mLines[aEnd.mLine];
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		firstLine.Erase(start, firstLine.size());
+		lastLine.Erase(0, end);
 
 		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+			firstLine.Append(lastLine);
 
 		if (aStart.mLine < aEnd.mLine)
 			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
@@ -259,13 +302,19 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue)
 {
 	assert(!mReadOnly);
+	assert(!mLines.empty());
 
-	int cindex = GetCharacterIndex(aWhere);
-	int totalLines = 0;
+	if (*aValue == '\0')
+		return 0;
+
+	// Split the text into line segments first, so the target line is
+	// spliced once and all new lines go in as a single bulk insert
+	// instead of one glyph and one line at a time.
+	std::vector<Line> newLines;
+	Line segment;
+	int columns = 0;
 	while (*aValue != '\0')
 	{
-		assert(!mLines.empty());
-
 		if (*aValue == '\r')
 		{
 			// skip
@@ -273,35 +322,47 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
 		}
 		else if (*aValue == '\n')
 		{
-			if (cindex < (int)mLines[aWhere.mLine].size())
-			{
-				auto& newLine = InsertLine(aWhere.mLine + 1);
-				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
-			}
-			else
-			{
-				InsertLine(aWhere.mLine + 1);
-			}
-			++aWhere.mLine;
-			aWhere.mColumn = 0;
-			cindex = 0;
-			++totalLines;
+			newLines.emplace_back(std::move(segment));
+			segment = Line();
+			columns = 0;
 			++aValue;
 		}
 		else
 		{
-			auto& line = mLines[aWhere.mLine];
+			auto begin = aValue;
 			auto d = UTF8CharLength(*aValue);
 			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+				++aValue;
+			segment.Insert(segment.size(), begin, aValue - begin);
+			++columns;
 		}
+	}
 
-		mTextChanged = true;
+	int totalLines = (int)newLines.size();
+	int cindex = GetCharacterIndex(aWhere);
+	auto& line = mLines[aWhere.mLine];
+	if (newLines.empty())
+	{
+		line.Insert(cindex, segment, 0, segment.size());
+		aWhere.mColumn += columns;
+	}
+	else
+	{
+		// The first segment ends the current line, the rest of the current
+		// line moves behind the last segment
+		segment.Append(line, cindex);
+		line.Erase(cindex, line.size());
+		line.Append(newLines.front());
+		newLines.front() = std::move(segment);
+		std::rotate(newLines.begin(), newLines.begin() + 1, newLines.end());
+
+		InsertLines(aWhere.mLine + 1, std::move(newLines));
+		aWhere.mLine += totalLines;
+		aWhere.mColumn = columns;
 	}
 
+	mTextChanged = true;
+
 	return totalLines;
 }
 
@@ -315,9 +376,124 @@ void TextEditor::AddUndo(UndoRecord& aValue)
 	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
 	//	);
 
-	mUndoBuffer.resize((size_t)(mUndoIndex + 1));
-	mUndoBuffer.back() = aValue;
-	++mUndoIndex;
+	if (!MergeUndo(aValue))
+	{
+		DropUndoSteps(mUndoIndex, mUndoBuffer.size());
+
+		// Removed text goes in first, so a step's text starts at mRemoved
+		UndoStep step;
+		step.mRemoved = mUndoText.Append(aValue.mRemoved.data(), aValue.mRemoved.size());
+		step.mRemovedStart = aValue.mRemovedStart;
+		step.mRemovedEnd = aValue.mRemovedEnd;
+		step.mAdded = mUndoText.Append(aValue.mAdded.data(), aValue.mAdded.size());
+		step.mAddedStart = aValue.mAddedStart;
+		step.mAddedEnd = aValue.mAddedEnd;
+		step.mBefore = aValue.mBefore;
+		step.mAfter = aValue.mAfter;
+
+		mUndoBuffer.push_back(step);
+		mUndoMemory += step.GetMemory();
+		++mUndoIndex;
+	}
+
+	LimitUndoMemory();
+}
+
+bool TextEditor::MergeUndo(const UndoRecord& aValue)
+{
+	// Characters typed one after another on the same line become one step,
+	// split where a word starts after whitespace
+	if (mUndoIndex == 0 || mUndoIndex != (int)mUndoBuffer.size())
+		return false;
+
+	auto& last = mUndoBuffer.back();
+	auto& added = aValue.mAdded;
+	if (!aValue.mRemoved.empty() || !last.mRemoved.empty() || last.mAdded.empty())
+		return false;
+	if (added.empty() || added[0] == '\n' || (int)added.size() != UTF8CharLength(added[0]))
+		return false;
+	if (last.mAddedStart.mLine != last.mAddedEnd.mLine || last.mAddedEnd != aValue.mAddedStart
+		|| last.mAfter.mCursorPosition != aValue.mBefore.mCursorPosition)
+		return false;
+
+	auto previous = mUndoText.Get(last.mAdded)[last.mAdded.mLength - 1];
+	if ((previous == ' ' || previous == '\t') && added[0] != ' ' && added[0] != '\t')
+		return false;
+
+	if (!mUndoText.Extend(last.mAdded, added.data(), added.size()))
+		return false;
+
+	mUndoMemory += added.size();
+	last.mAddedEnd = aValue.mAddedEnd;
+	last.mAfter = aValue.mAfter;
+	return true;
+}
+
+void TextEditor::DropUndoSteps(size_t aFirst, size_t aLast)
+{
+	// Only ever the oldest steps or the redo steps at the end, whose text is
+	// at the front or the back of mUndoText
+	if (aFirst >= aLast)
+		return;
+
+	auto textOf = [](const UndoStep& aStep) { return aStep.mRemoved.empty() ? aStep.mAdded : aStep.mRemoved; };
+
+	for (auto i = aFirst; i < aLast; ++i)
+		mUndoMemory -= mUndoBuffer[i].GetMemory();
+
+	if (aLast == mUndoBuffer.size())
+	{
+		for (auto i = aFirst; i < aLast; ++i)
+		{
+			auto text = textOf(mUndoBuffer[i]);
+			if (!text.empty())
+			{
+				mUndoText.DropFrom(text.mOffset);
+				break;
+			}
+		}
+		mUndoBuffer.erase(mUndoBuffer.begin() + aFirst, mUndoBuffer.end());
+	}
+	else
+	{
+		assert(aFirst == 0);
+		mUndoBuffer.erase(mUndoBuffer.begin(), mUndoBuffer.begin() + aLast);
+
+		auto it = std::find_if(mUndoBuffer.begin(), mUndoBuffer.end(), [&](const UndoStep& aStep) { return !textOf(aStep).empty(); });
+		if (it != mUndoBuffer.end())
+			mUndoText.DropBefore(textOf(*it).mOffset);
+		else
+			mUndoText.Clear();
+	}
+
+	if (mUndoIndex >= (int)aLast)
+		mUndoIndex -= (int)(aLast - aFirst);
+	else
+		mUndoIndex = std::min(mUndoIndex, (int)aFirst);
+}
+
+void TextEditor::LimitUndoMemory()
+{
+	// Evict the oldest steps, but keep the latest one whatever its size, and
+	// never a step that is still to be redone
+	size_t count = 0;
+	for (auto memory = mUndoMemory; memory > mUndoMemoryLimit && count + 1 < mUndoBuffer.size() && count < (size_t)mUndoIndex; ++count)
+		memory -= mUndoBuffer[count].GetMemory();
+	DropUndoSteps(0, count);
+}
+
+void TextEditor::ClearUndo()
+{
+	mUndoBuffer.clear();
+	mUndoIndex = 0;
+	mUndoText.Clear();
+	mUndoMemory = 0;
+}
+
+void TextEditor::SetUndoMemoryLimit(size_t aValue)
+{
+	mUndoMemoryLimit = aValue;
+	LimitUndoMemory();
 }
 
 TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
@@ -331,42 +507,21 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 
 	if (lineNo >= 0 && lineNo < (int)mLines.size())
 	{
-		auto& line = mLines.at(lineNo);
-
-		int columnIndex = 0;
-		float columnX = 0.0f;
-
-		while ((size_t)columnIndex < line.size())
+		// The first character whose middle lies right of the position; the
+		// midpoints only grow along the line, so a binary search finds it
+		auto& layout = GetLineOffsets(mLines.at(lineNo));
+		auto& offsets = layout.mOffsets;
+		int low = 0;
+		int high = (int)offsets.size() - 1;
+		while (low < high)
 		{
-			float columnWidth = 0.0f;
-
-			if (line[columnIndex].mChar == '\t')
-			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX = newColumnX;
-				columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
-				columnIndex++;
-			}
+			auto mid = (low + high) / 2;
+			if (mTextStart + offsets[mid] + (offsets[mid + 1] - offsets[mid]) * 0.5f > local.x)
+				high = mid;
 			else
-			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].mChar);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].mChar;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX += columnWidth;
-				columnCoord++;
-			}
+				low = mid + 1;
 		}
+		columnCoord = layout.mColumns[low];
 	}
 
 	return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
@@ -384,13 +539,13 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 	if (cindex >= (int)line.size())
 		return at;
 
-	while (cindex > 0 && isspace(line[cindex].mChar))
+	while (cindex > 0 && isspace(line.GetChar(cindex)))
 		--cindex;
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex > 0)
 	{
-		auto c = line[cindex].mChar;
+		auto c = line.GetChar(cindex);
 		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
 		{
 			if (c <= 32 && isspace(c))
@@ -398,7 +553,7 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 				cindex++;
 				break;
 			}
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].mColorIndex)
+			if (cstart != line.GetColorIndex(size_t(cindex - 1)))
 				break;
 		}
 		--cindex;
@@ -418,19 +573,19 @@ TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
 	if (cindex >= (int)line.size())
 		return at;
 
-	bool prevspace = isspace(line[cindex].mChar) != 0;
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	bool prevspace = isspace(line.GetChar(cindex)) != 0;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex < (int)line.size())
 	{
-		auto c = line[cindex].mChar;
+		auto c = line.GetChar(cindex);
 		auto d = UTF8CharLength(c);
-		if (cstart != (PaletteIndex)line[cindex].mColorIndex)
+		if (cstart != line.GetColorIndex(cindex))
 			break;
 
 		if (prevspace != !!isspace(c))
 		{
 			if (isspace(c))
-				while (cindex < (int)line.size() && isspace(line[cindex].mChar))
+				while (cindex < (int)line.size() && isspace(line.GetChar(cindex)))
 					++cindex;
 			break;
 		}
@@ -452,7 +607,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 	if (cindex < (int)mLines[at.mLine].size())
 	{
 		auto& line = mLines[at.mLine];
-		isword = isalnum(line[cindex].mChar) != 0;
+		isword = isalnum(line.GetChar(cindex)) != 0;
 		skip = isword;
 	}
 
@@ -467,7 +622,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 		auto& line = mLines[at.mLine];
 		if (cindex < (int)line.size())
 		{
-			isword = isalnum(line[cindex].mChar) != 0;
+			isword = isalnum(line.GetChar(cindex)) != 0;
 
 			if (isword && !skip)
 				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
@@ -498,11 +653,11 @@ int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 	int i = 0;
 	for (; i < line.size() && c < aCoordinates.mColumn;)
 	{
-		if (line[i].mChar == '\t')
+		if (line.GetChar(i) == '\t')
 			c = (c / mTabSize) * mTabSize + mTabSize;
 		else
 			++c;
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line.GetChar(i));
 	}
 	return i;
 }
@@ -516,7 +671,7 @@ int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 	int i = 0;
 	while (i < aIndex && i < (int)line.size())
 	{
-		auto c = line[i].mChar;
+		auto c = line.GetChar(i);
 		i += UTF8CharLength(c);
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
@@ -533,7 +688,7 @@ int TextEditor::GetLineCharacterCount(int aLine) const
 	auto& line = mLines[aLine];
 	int c = 0;
 	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line.GetChar(i));
 	return c;
 }
 
@@ -545,7 +700,7 @@ int TextEditor::GetLineMaxColumn(int aLine) const
 	int col = 0;
 	for (unsigned i = 0; i < line.size(); )
 	{
-		auto c = line[i].mChar;
+		auto c = line.GetChar(i);
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
 		else
@@ -566,9 +721,9 @@ bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
 		return true;
 
 	if (mColorizerEnabled)
-		return line[cindex].mColorIndex != line[size_t(cindex - 1)].mColorIndex;
+		return line.GetColorIndex(cindex) != line.GetColorIndex(size_t(cindex - 1));
 
-	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
+	return isspace(line.GetChar(cindex)) != isspace(line.GetChar(cindex - 1));
 }
 
 void TextEditor::RemoveLine(int aStart, int aEnd)
@@ -596,9 +751,16 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
+	for (int i = aStart; i < aEnd; ++i)
+	{
+		ForgetLineWidth(mLines[i]);
+		ForgetLineMatches(mLines[i]);
+	}
+	mLines.erase(aStart, aEnd);
 	assert(!mLines.empty());
 
+	ShiftPendingScans(aStart, aStart - aEnd);
+
 	mTextChanged = true;
 }
 
@@ -626,17 +788,54 @@ void TextEditor::RemoveLine(int aIndex)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aIndex);
+	ForgetLineWidth(mLines[aIndex]);
+	ForgetLineMatches(mLines[aIndex]);
+	mLines.erase(aIndex);
 	assert(!mLines.empty());
 
+	ShiftPendingScans(aIndex, -1);
+
 	mTextChanged = true;
 }
 
+void TextEditor::ShiftPendingScans(int aIndex, int aDelta)
+{
+	// Keep the pending comment scan, the pending colorize ranges, the lines
+	// out on the colorizer thread and the lines waiting to be measured or
+	// searched on the same lines when lines are inserted (aDelta > 0) or
+	// removed (aDelta < 0) at aIndex
+	auto shift = [aIndex, aDelta](int& aMin, int& aMax)
+	{
+		if (aMin >= aMax)
+			return;
+
+		if (aDelta < 0 && aMin > aIndex)
+			aMin = std::max(aIndex, aMin + aDelta);
+		if (aMax > aIndex)
+			aMax = std::max(aIndex, aMax + aDelta);
+	};
+
+	shift(mCommentScanMin, mCommentScanMax);
+	shift(mColorizeJobMin, mColorizeJobMax);
+	shift(mMeasureMin, mMeasureMax);
+	shift(mSearchMin, mSearchMax);
+
+	std::map<int, int> ranges;
+	ranges.swap(mColorRanges);
+	for (auto& range : ranges)
+	{
+		int first = range.first, last = range.second;
+		shift(first, last);
+		AddColorRange(first, last);
+	}
+}
+
 TextEditor::Line& TextEditor::InsertLine(int aIndex)
 {
 	assert(!mReadOnly);
 
-	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	auto& result = mLines.insert(aIndex, Line());
+	ShiftPendingScans(aIndex, 1);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -651,6 +850,28 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 	return result;
 }
 
+void TextEditor::InsertLines(int aIndex, std::vector<Line>&& aLines)
+{
+	assert(!mReadOnly);
+
+	auto count = (int)aLines.size();
+	if (count == 0)
+		return;
+
+	mLines.insert(aIndex, std::move(aLines));
+	ShiftPendingScans(aIndex, count);
+
+	ErrorMarkers etmp;
+	for (auto& i : mErrorMarkers)
+		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + count : i.first, i.second));
+	mErrorMarkers = std::move(etmp);
+
+	Breakpoints btmp;
+	for (auto i : mBreakpoints)
+		btmp.insert(i >= aIndex ? i + count : i);
+	mBreakpoints = std::move(btmp);
+}
+
 std::string TextEditor::GetWordUnderCursor() const
 {
 	auto c = GetCursorPosition();
@@ -668,21 +889,268 @@ std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
 	auto iend = GetCharacterIndex(end);
 
 	for (auto it = istart; it < iend; ++it)
-		r.push_back(mLines[aCoords.mLine][it].mChar);
+		r.push_back(mLines[aCoords.mLine].GetChar(it));
 
 	return r;
 }
 
-ImU32 TextEditor::GetGlyphColor(const Glyph & aGlyph) const
+TextEditor::LineLayout& TextEditor::GetLineLayout(const Line& aLine) const
+{
+	if (aLine.mStamp != 0)
+	{
+		auto it = mLineLayouts.find(aLine.mStamp);
+		if (it != mLineLayouts.end())
+		{
+			it->second.mLastFrame = mRenderFrame;
+			return it->second;
+		}
+	}
+
+	// Stamps are only ever handed out once, so when they run out every line
+	// has to forget the one it holds
+	if (++mLastStamp == 0)
+	{
+		for (auto& line : mLines)
+			line.mStamp = 0;
+		mLineLayouts.clear();
+		mLastStamp = 1;
+	}
+
+	aLine.mStamp = mLastStamp;
+	auto& layout = mLineLayouts[aLine.mStamp];
+	layout.mLastFrame = mRenderFrame;
+	return layout;
+}
+
+const std::vector<TextEditor::DrawRun>& TextEditor::GetDrawRuns(const Line& aLine) const
+{
+	auto& layout = GetLineLayout(aLine);
+	if (!layout.mHasRuns)
+	{
+		BuildDrawRuns(aLine, layout.mRuns);
+		layout.mHasRuns = true;
+	}
+	return layout.mRuns;
+}
+
+const TextEditor::LineLayout& TextEditor::GetLineOffsets(const Line& aLine) const
+{
+	auto& layout = GetLineLayout(aLine);
+	if (layout.mOffsets.empty())
+		BuildLineOffsets(aLine, layout);
+	return layout;
+}
+
+void TextEditor::BuildDrawRuns(const Line& aLine, std::vector<DrawRun>& aRuns) const
+{
+	// Split the line where the colour changes and around every space and
+	// tab, measuring each piece once
+	aRuns.clear();
+	const char* text = aLine.mText.c_str();
+	const float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	const float tabSize = float(mTabSize) * spaceSize;
+	float x = 0.0f;
+	int runStart = 0;
+	ImU32 runColor = 0;
+
+	auto flush = [&](int aEnd)
+	{
+		if (runStart < aEnd)
+		{
+			auto width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, text + runStart, text + aEnd, nullptr).x;
+			aRuns.push_back({ runStart, aEnd, x, x + width, runColor });
+			x += width;
+		}
+	};
+
+	for (int i = 0; i < (int)aLine.size(); )
+	{
+		auto c = aLine.GetChar(i);
+		if (c == '\t' || c == ' ')
+		{
+			flush(i);
+			auto endX = c == '\t' ? (1.0f + std::floor((1.0f + x) / tabSize)) * tabSize : x + spaceSize;
+			aRuns.push_back({ i, i + 1, x, endX, 0 });
+			x = endX;
+			runStart = ++i;
+			continue;
+		}
+
+		auto color = GetGlyphColor(aLine.mAttributes[i]);
+		if (color != runColor)
+		{
+			flush(i);
+			runStart = i;
+			runColor = color;
+		}
+		i = std::min(i + UTF8CharLength(c), (int)aLine.size());
+	}
+	flush((int)aLine.size());
+}
+
+void TextEditor::BuildLineOffsets(const Line& aLine, LineLayout& aLayout) const
+{
+	// Measured one character at a time, exactly like the cursor has always
+	// been placed, so positions don't drift from what was there before
+	const float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	const int size = (int)aLine.size();
+	aLayout.mOffsets.resize(size + 1);
+	aLayout.mColumns.resize(size + 1);
+
+	float x = 0.0f;
+	int column = 0;
+	for (int i = 0; i < size; )
+	{
+		aLayout.mOffsets[i] = x;
+		aLayout.mColumns[i] = column;
+
+		auto c = aLine.GetChar(i);
+		if (c == '\t')
+		{
+			x = (1.0f + std::floor((1.0f + x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+			column = (column / mTabSize) * mTabSize + mTabSize;
+			++i;
+		}
+		else
+		{
+			auto d = UTF8CharLength(c);
+			char tempCString[7];
+			int n = 0;
+			for (; n < 6 && n < d && i + n < size; n++)
+				tempCString[n] = aLine.GetChar(i + n);
+
+			tempCString[n] = '\0';
+			x += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+			++column;
+
+			for (int j = 1; j < n; ++j)
+			{
+				aLayout.mOffsets[i + j] = x;
+				aLayout.mColumns[i + j] = column;
+			}
+			i += n;
+		}
+	}
+	aLayout.mOffsets[size] = x;
+	aLayout.mColumns[size] = column;
+}
+
+float TextEditor::MeasureLine(const Line& aLine) const
+{
+	// Adds up the same pieces BuildDrawRuns measures, minus the colour splits
+	const char* text = aLine.mText.c_str();
+	const float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	const float tabSize = float(mTabSize) * spaceSize;
+	const int size = (int)aLine.size();
+	float x = 0.0f;
+	int wordStart = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		auto c = aLine.GetChar(i);
+		if (c != '\t' && c != ' ')
+			continue;
+
+		if (wordStart < i)
+			x += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, text + wordStart, text + i, nullptr).x;
+		x = c == '\t' ? (1.0f + std::floor((1.0f + x) / tabSize)) * tabSize : x + spaceSize;
+		wordStart = i + 1;
+	}
+	if (wordStart < size)
+		x += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, text + wordStart, text + size, nullptr).x;
+	return x;
+}
+
+void TextEditor::MeasureLines()
+{
+	// Re-measure the lines edited since the last frame, a bounded number at
+	// a time so that opening a large file does not stall a frame
+	if (mMeasureMin >= mMeasureMax)
+		return;
+
+	auto end = std::min(mMeasureMax, (int)mLines.size());
+	auto last = std::min(end, mMeasureMin + kMeasureLinesPerFrame);
+	for (int i = mMeasureMin; i < last; ++i)
+	{
+		auto& line = mLines[i];
+		ForgetLineWidth(line);
+		line.mWidth = MeasureLine(line);
+		++mLineWidths[line.mWidth];
+	}
+
+	mMeasureMin = last;
+	if (mMeasureMin >= end)
+	{
+		mMeasureMin = std::numeric_limits<int>::max();
+		mMeasureMax = 0;
+	}
+}
+
+void TextEditor::ForgetLineWidth(Line& aLine)
+{
+	if (aLine.mWidth < 0.0f)
+		return;
+
+	auto it = mLineWidths.find(aLine.mWidth);
+	if (--it->second == 0)
+		mLineWidths.erase(it);
+	aLine.mWidth = -1.0f;
+}
+
+void TextEditor::IndexSearch()
+{
+	// Count the matches on the lines edited since the last frame, or on all
+	// of them after a new query, a bounded amount of text at a time
+	if (mSearchMin >= mSearchMax)
+		return;
+
+	auto end = std::min(mSearchMax, (int)mLines.size());
+	auto budget = mSearch.IsRegex() ? kRegexSearchBytesPerFrame : kSearchBytesPerFrame;
+	auto i = mSearchMin;
+	for (size_t searched = 0; i < end && searched < budget; ++i)
+	{
+		auto& line = mLines[i];
+		ForgetLineMatches(line);
+		line.mMatches = mSearch.Count(line.mText.data(), line.size());
+		line.mSearchSkipped = mSearch.Skips(line.size());
+		mSearchMatchCount += line.mMatches;
+		mSearchSkippedLines += line.mSearchSkipped ? 1 : 0;
+		searched += line.size() + 1;
+	}
+
+	mSearchMin = i;
+	if (mSearchMin >= end)
+	{
+		mSearchMin = std::numeric_limits<int>::max();
+		mSearchMax = 0;
+	}
+}
+
+void TextEditor::ForgetLineMatches(Line& aLine)
+{
+	if (aLine.mMatches < 0)
+		return;
+
+	mSearchMatchCount -= aLine.mMatches;
+	mSearchSkippedLines -= aLine.mSearchSkipped ? 1 : 0;
+	aLine.mMatches = -1;
+	aLine.mSearchSkipped = false;
+}
+
+bool TextEditor::MayHaveMatches(int aLine) const
+{
+	return mLines[aLine].mMatches != 0 || (aLine >= mSearchMin && aLine < mSearchMax);
+}
+
+ImU32 TextEditor::GetGlyphColor(Attributes aAttributes) const
 {
 	if (!mColorizerEnabled)
 		return mPalette[(int)PaletteIndex::Default];
-	if (aGlyph.mComment)
+	if (aAttributes & CommentFlag)
 		return mPalette[(int)PaletteIndex::Comment];
-	if (aGlyph.mMultiLineComment)
+	if (aAttributes & MultiLineCommentFlag)
 		return mPalette[(int)PaletteIndex::MultiLineComment];
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
+	auto const color = mPalette[aAttributes & ColorIndexMask];
+	if (aAttributes & PreprocessorFlag)
 	{
 		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
 		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
@@ -864,7 +1332,30 @@ void TextEditor::Render()
 		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
 	}
 
-	assert(mLineBuffer.empty());
+	// Cached layouts only hold for the font, palette and tab size they were built with
+	DrawRunsKey runsKey;
+	runsKey.mPalette = mPalette;
+	runsKey.mFont = ImGui::GetFont();
+	runsKey.mFontSize = ImGui::GetFontSize();
+	runsKey.mTabSize = mTabSize;
+	runsKey.mColorizerEnabled = mColorizerEnabled;
+	if (!(runsKey == mDrawRunsKey))
+	{
+		// Line widths only change with the font and tab size
+		if (runsKey.mFont != mDrawRunsKey.mFont || runsKey.mFontSize != mDrawRunsKey.mFontSize || runsKey.mTabSize != mDrawRunsKey.mTabSize)
+		{
+			for (auto& line : mLines)
+				line.mWidth = -1.0f;
+			mLineWidths.clear();
+			mMeasureMin = 0;
+			mMeasureMax = (int)mLines.size();
+		}
+		mLineLayouts.clear();
+		mDrawRunsKey = runsKey;
+	}
+	++mRenderFrame;
+	MeasureLines();
+	IndexSearch();
 
 	auto contentSize = ImGui::GetWindowContentRegionMax();
 	auto drawList = ImGui::GetWindowDrawList();
@@ -883,12 +1374,19 @@ void TextEditor::Render()
 	auto lineNo = (int)floor(scrollY / mCharAdvance.y);
 	auto globalLineMax = (int)mLines.size();
 	auto lineMax = std::max(0, std::min((int)mLines.size() - 1, lineNo + (int)floor((scrollY + contentSize.y) / mCharAdvance.y)));
+	mFirstVisibleLine = lineNo;
+	mLastVisibleLine = lineMax;
 
 	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
 	char buf[16];
 	snprintf(buf, 16, " %d ", globalLineMax);
 	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
 
+	// Size the scroll extent for the longest line measured anywhere; visible
+	// lines not measured yet are still taken into account below
+	if (!mLineWidths.empty())
+		longest = std::max(mTextStart + mLineWidths.rbegin()->first, longest);
+
 	if (!mLines.empty())
 	{
 		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
@@ -899,8 +1397,8 @@ void TextEditor::Render()
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 
 			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
+			auto& runs = GetDrawRuns(line);
+			longest = std::max(mTextStart + (runs.empty() ? 0.0f : runs.back().mEndX), longest);
 			Coordinates lineStartCoord(lineNo, 0);
 			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
 
@@ -924,6 +1422,19 @@ void TextEditor::Render()
 				drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::Selection]);
 			}
 
+			// Draw search matches
+			if (!mSearch.IsEmpty() && MayHaveMatches(lineNo))
+			{
+				auto& layout = GetLineOffsets(line);
+				size_t begin, end;
+				for (size_t from = 0; mSearch.Find(line.mText.data(), line.size(), from, begin, end); from = end)
+				{
+					ImVec2 vstart(textScreenPos.x + layout.mOffsets[begin], lineStartScreenPos.y);
+					ImVec2 vend(textScreenPos.x + layout.mOffsets[end], lineStartScreenPos.y + mCharAdvance.y);
+					drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::SearchMatch]);
+				}
+			}
+
 			// Draw breakpoints
 			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
 
@@ -985,7 +1496,7 @@ void TextEditor::Render()
 
 						if (mOverwrite && cindex < (int)line.size())
 						{
-							auto c = line[cindex].mChar;
+							auto c = line.GetChar(cindex);
 							if (c == '\t')
 							{
 								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
@@ -994,7 +1505,7 @@ void TextEditor::Render()
 							else
 							{
 								char buf2[2];
-								buf2[0] = line[cindex].mChar;
+								buf2[0] = line.GetChar(cindex);
 								buf2[1] = '\0';
 								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
 							}
@@ -1008,37 +1519,19 @@ void TextEditor::Render()
 				}
 			}
 
-			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
-			ImVec2 bufferOffset;
-
-			for (int i = 0; i < line.size();)
+			// Render colorized text from the line's cached runs
+			const char* text = line.mText.c_str();
+			for (auto& run : runs)
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
-
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
-
-				if (glyph.mChar == '\t')
+				auto c = text[run.mBegin];
+				if (c == '\t')
 				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-					++i;
-
 					if (mShowWhitespaces)
 					{
 						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x1 = textScreenPos.x + run.mX + 1.0f;
+						const auto x2 = textScreenPos.x + run.mEndX - 1.0f;
+						const auto y = textScreenPos.y + s * 0.5f;
 						const ImVec2 p1(x1, y);
 						const ImVec2 p2(x2, y);
 						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
@@ -1048,35 +1541,35 @@ void TextEditor::Render()
 						drawList->AddLine(p2, p4, 0x90909090);
 					}
 				}
-				else if (glyph.mChar == ' ')
+				else if (c == ' ')
 				{
 					if (mShowWhitespaces)
 					{
 						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x = textScreenPos.x + run.mX + spaceSize * 0.5f;
+						const auto y = textScreenPos.y + s * 0.5f;
 						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
 					}
-					bufferOffset.x += spaceSize;
-					i++;
 				}
 				else
 				{
-					auto l = UTF8CharLength(glyph.mChar);
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
+					drawList->AddText(ImVec2(textScreenPos.x + run.mX, textScreenPos.y), run.mColor, text + run.mBegin, text + run.mEnd);
 				}
-				++columnNo;
 			}
 
-			if (!mLineBuffer.empty())
+			++lineNo;
+		}
+
+		// Forget the layout of lines that scrolled out of view or changed
+		if (mLineLayouts.size() > 2 * (size_t)(lineMax - mFirstVisibleLine + 1) + 64)
+		{
+			for (auto it = mLineLayouts.begin(); it != mLineLayouts.end(); )
 			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
+				if (it->second.mLastFrame != mRenderFrame)
+					it = mLineLayouts.erase(it);
+				else
+					++it;
 			}
-
-			++lineNo;
 		}
 
 		// Draw a tooltip on known identifiers/preprocessor symbols
@@ -1112,8 +1605,10 @@ void TextEditor::Render()
 	if (mScrollToCursor)
 	{
 		EnsureCursorVisible();
-		ImGui::SetWindowFocus();
+		if (!mScrollKeepFocus)
+			ImGui::SetWindowFocus();
 		mScrollToCursor = false;
+		mScrollKeepFocus = false;
 	}
 }
 
@@ -1154,27 +1649,127 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 
 void TextEditor::SetText(const std::string & aText)
 {
-	mLines.clear();
-	mLines.emplace_back(Line());
-	for (auto chr : aText)
+	SetText(aText.data(), aText.size());
+}
+
+void TextEditor::SetText(const char * aText, size_t aLength)
+{
+	SetLines(BuildLines(aText, aLength));
+}
+
+TextEditor::Lines TextEditor::BuildLines(const char * aText, size_t aLength, const ProgressCallback& aProgress)
+{
+	// Report (and poll for cancellation) once per this many bytes
+	static const size_t kProgressStep = 1024 * 1024;
+	// Smallest piece of text worth a thread of its own
+	static const size_t kParallelChunkSize = 2 * 1024 * 1024;
+
+	std::atomic<size_t> done(0);
+	std::atomic<bool> cancelled(false);
+
+	// Splits [aBegin, aEnd) into aOut. Every '\n' ends a line, the carriage
+	// return character is dropped, and only the last chunk keeps what follows
+	// its final newline as a line of its own.
+	auto buildChunk = [&](size_t aBegin, size_t aEnd, bool aLast, std::vector<Line>& aOut, bool aReport)
 	{
-		if (chr == '\r')
-		{
-			// ignore the carriage return character
-		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
-		else
+		aOut.reserve(std::count(aText + aBegin, aText + aEnd, '\n') + (aLast ? 1 : 0));
+
+		size_t nextReport = aBegin + kProgressStep;
+		size_t start = aBegin;
+		while (start < aEnd || (aLast && start == aEnd))
 		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
+			auto newline = start < aEnd ? (const char*)memchr(aText + start, '\n', aEnd - start) : nullptr;
+			size_t end = newline != nullptr ? (size_t)(newline - aText) : aEnd;
+
+			auto text = aText + start;
+			size_t length = end - start;
+			if (length > 0 && text[length - 1] == '\r')
+				--length;
+
+			aOut.emplace_back();
+			auto& line = aOut.back();
+			if (length == 0 || memchr(text, '\r', length) == nullptr)
+			{
+				line.Reserve(length);
+				line.Insert(0, text, length);
+			}
+			else
+			{
+				std::string stripped;
+				stripped.reserve(length);
+				for (size_t i = 0; i < length; ++i)
+					if (text[i] != '\r')
+						stripped.push_back(text[i]);
+				line.Reserve(stripped.size());
+				line.Insert(0, stripped.data(), stripped.size());
+			}
+
+			if (newline == nullptr)
+				break;
+			start = end + 1;
+
+			if (start >= nextReport)
+			{
+				done += start - (nextReport - kProgressStep);
+				nextReport = start + kProgressStep;
+				if (cancelled)
+					return;
+				if (aReport && aProgress && !aProgress((float)done / (float)aLength))
+				{
+					cancelled = true;
+					return;
+				}
+			}
 		}
+	};
+
+	// Cut the text after a newline near every chunk boundary
+	size_t chunkCount = 1;
+	if (aLength >= 2 * kParallelChunkSize)
+		chunkCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), aLength / kParallelChunkSize);
+
+	std::vector<size_t> bounds(1, 0);
+	for (size_t i = 1; i < chunkCount; ++i)
+	{
+		size_t at = std::max(bounds.back(), aLength / chunkCount * i);
+		auto newline = (const char*)memchr(aText + at, '\n', aLength - at);
+		if (newline == nullptr)
+			break;
+		bounds.push_back((size_t)(newline - aText) + 1);
 	}
+	bounds.push_back(aLength);
+	chunkCount = bounds.size() - 1;
+
+	// The calling thread takes the first chunk and does the reporting
+	std::vector<std::vector<Line>> chunks(chunkCount);
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunkCount; ++i)
+		workers.emplace_back(buildChunk, bounds[i], bounds[i + 1], i + 1 == chunkCount, std::ref(chunks[i]), false);
+	buildChunk(bounds[0], bounds[1], chunkCount == 1, chunks[0], true);
+	for (auto& worker : workers)
+		worker.join();
+
+	Lines lines;
+	if (cancelled)
+		return lines;
+	for (auto& chunk : chunks)
+		lines.insert(lines.size(), std::move(chunk));
+	return lines;
+}
+
+void TextEditor::SetLines(Lines&& aLines)
+{
+	mLines = std::move(aLines);
+	if (mLines.empty())
+		mLines.emplace_back(Line());
+	mLineWidths.clear();
+	mSearchMatchCount = 0;
+	mSearchSkippedLines = 0;
 
 	mTextChanged = true;
 	mScrollToTop = true;
 
-	mUndoBuffer.clear();
-	mUndoIndex = 0;
+	ClearUndo();
 
 	Colorize();
 }
@@ -1182,6 +1777,9 @@ void TextEditor::SetText(const std::string & aText)
 void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 {
 	mLines.clear();
+	mLineWidths.clear();
+	mSearchMatchCount = 0;
+	mSearchSkippedLines = 0;
 
 	if (aLines.empty())
 	{
@@ -1195,17 +1793,14 @@ void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 		{
 			const std::string & aLine = aLines[i];
 
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
+			mLines[i].Insert(0, aLine.data(), aLine.size());
 		}
 	}
 
 	mTextChanged = true;
 	mScrollToTop = true;
 
-	mUndoBuffer.clear();
-	mUndoIndex = 0;
+	ClearUndo();
 
 	Colorize();
 }
@@ -1253,16 +1848,16 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				{
 					if (!line.empty())
 					{
-						if (line.front().mChar == '\t')
+						if (line.GetChar(0) == '\t')
 						{
-							line.erase(line.begin());
+							line.Erase(0, 1);
 							modified = true;
 						}
 						else
 						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							for (int j = 0; j < mTabSize && !line.empty() && line.GetChar(0) == ' '; j++)
 							{
-								line.erase(line.begin());
+								line.Erase(0, 1);
 								modified = true;
 							}
 						}
@@ -1270,7 +1865,8 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				}
 				else
 				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
+					line.Insert(0, "\t", 1);
+					line.SetColorIndex(0, TextEditor::PaletteIndex::Background);
 					modified = true;
 				}
 			}
@@ -1301,6 +1897,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				AddUndo(u);
 
 				mTextChanged = true;
+				Colorize(start.mLine, end.mLine - start.mLine + 1);
 
 				EnsureCursorVisible();
 			}
@@ -1328,13 +1925,17 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 		auto& newLine = mLines[coord.mLine + 1];
 
 		if (mLanguageDefinition.mAutoIndentation)
-			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
+		{
+			size_t it = 0;
+			while (it < line.size() && isascii(line.GetChar(it)) && isblank(line.GetChar(it)))
+				++it;
+			newLine.Insert(0, line, 0, it);
+		}
 
 		const size_t whitespaceSize = newLine.size();
 		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
+		newLine.Append(line, cindex);
+		line.Erase(cindex, line.size());
 		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
 		u.mAdded = (char)aChar;
 	}
@@ -1350,20 +1951,18 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
 			if (mOverwrite && cindex < (int)line.size())
 			{
-				auto d = UTF8CharLength(line[cindex].mChar);
+				auto d = UTF8CharLength(line.GetChar(cindex));
 
 				u.mRemovedStart = mState.mCursorPosition;
 				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
-				}
+				d = std::min(d, (int)line.size() - cindex);
+				u.mRemoved.append(line.mText, cindex, d);
+				line.Erase(cindex, cindex + d);
 			}
 
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+			line.Insert(cindex, buf, e);
+			cindex += e;
 			u.mAdded = buf;
 
 			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
@@ -1584,7 +2183,7 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			{
 				if ((int)mLines.size() > line)
 				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+					while (cindex > 0 && IsUTFSequence(mLines[line].GetChar(cindex)))
 						--cindex;
 				}
 			}
@@ -1645,7 +2244,7 @@ void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 		}
 		else
 		{
-			cindex += UTF8CharLength(line[cindex].mChar);
+			cindex += UTF8CharLength(line.GetChar(cindex));
 			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
 			if (aWordMode)
 				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
@@ -1788,7 +2387,7 @@ void TextEditor::Delete()
 			Advance(u.mRemovedEnd);
 
 			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
+			line.Append(nextLine);
 			RemoveLine(pos.mLine + 1);
 		}
 		else
@@ -1798,9 +2397,8 @@ void TextEditor::Delete()
 			u.mRemovedEnd.mColumn++;
 			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
 
-			auto d = UTF8CharLength(line[cindex].mChar);
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+			auto d = UTF8CharLength(line.GetChar(cindex));
+			line.Erase(cindex, std::min(cindex + d, (int)line.size()));
 		}
 
 		mTextChanged = true;
@@ -1847,7 +2445,7 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
 			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+			prevLine.Append(line);
 
 			ErrorMarkers etmp;
 			for (auto& i : mErrorMarkers)
@@ -1863,20 +2461,21 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto cindex = GetCharacterIndex(pos) - 1;
 			auto cend = cindex + 1;
-			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
+			while (cindex > 0 && IsUTFSequence(line.GetChar(cindex)))
 				--cindex;
 
-			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
+			//if (cindex > 0 && UTF8CharLength(line.GetChar(cindex)) > 1)
 			//	--cindex;
 
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
 			--u.mRemovedStart.mColumn;
 			--mState.mCursorPosition.mColumn;
 
-			while (cindex < line.size() && cend-- > cindex)
+			cend = std::min(cend, (int)line.size());
+			if (cindex >= 0 && cindex < cend)
 			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
+				u.mRemoved.append(line.mText, cindex, cend - cindex);
+				line.Erase(cindex, cend);
 			}
 		}
 
@@ -1916,11 +2515,8 @@ void TextEditor::Copy()
 	{
 		if (!mLines.empty())
 		{
-			std::string str;
 			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
-				str.push_back(g.mChar);
-			ImGui::SetClipboardText(str.c_str());
+			ImGui::SetClipboardText(line.mText.c_str());
 		}
 	}
 }
@@ -2002,6 +2598,219 @@ void TextEditor::Redo(int aSteps)
 		mUndoBuffer[mUndoIndex++].Redo(this);
 }
 
+bool TextEditor::SetSearch(const std::string& aQuery, bool aRegex, bool aCaseSensitive)
+{
+	auto result = mSearch.Compile(aQuery, aRegex, aCaseSensitive, mSearchError);
+
+	// Every line is counted again from the top
+	for (auto& line : mLines)
+	{
+		line.mMatches = -1;
+		line.mSearchSkipped = false;
+	}
+	mSearchMatchCount = 0;
+	mSearchSkippedLines = 0;
+	mSearchMin = mSearch.IsEmpty() ? std::numeric_limits<int>::max() : 0;
+	mSearchMax = mSearch.IsEmpty() ? 0 : (int)mLines.size();
+	return result;
+}
+
+void TextEditor::ClearSearch()
+{
+	SetSearch(std::string());
+}
+
+TextEditor::Coordinates TextEditor::GetInsertedEnd(const Coordinates& aStart, const std::string& aText) const
+{
+	// Worked out from bytes, as InsertTextAt counts a tab as a single column
+	auto lines = (int)std::count(aText.begin(), aText.end(), '\n');
+	auto lastNewline = aText.rfind('\n');
+	auto index = lastNewline == std::string::npos ? GetCharacterIndex(aStart) + aText.size() : aText.size() - lastNewline - 1;
+	return Coordinates(aStart.mLine + lines, GetCharacterColumn(aStart.mLine + lines, (int)index));
+}
+
+void TextEditor::SelectFound(const Coordinates& aStart, const Coordinates& aEnd)
+{
+	// Scrolls there without taking the keyboard from a find field
+	mState.mCursorPosition = aEnd;
+	mCursorPositionChanged = true;
+	SetSelection(aStart, aEnd);
+	mScrollToCursor = true;
+	mScrollKeepFocus = true;
+}
+
+bool TextEditor::FindNext(bool aBackwards)
+{
+	if (mSearch.IsEmpty())
+		return false;
+
+	// Start past the selection, so a selected match is stepped over
+	auto origin = GetActualCursorCoordinates();
+	if (HasSelection())
+		origin = aBackwards ? mState.mSelectionStart : mState.mSelectionEnd;
+	auto originIndex = (size_t)std::max(0, GetCharacterIndex(origin));
+
+	// The origin line is looked at again last, for the matches on the other
+	// side of the origin after wrapping around
+	auto count = (int)mLines.size();
+	for (int k = 0; k <= count; ++k)
+	{
+		auto lineNo = aBackwards ? (origin.mLine - k % count + count) % count : (origin.mLine + k) % count;
+		if (!MayHaveMatches(lineNo))
+			continue;
+
+		auto& line = mLines[lineNo];
+		auto text = line.mText.data();
+		size_t begin = 0, end = 0;
+		bool found = false;
+		if (!aBackwards)
+		{
+			found = mSearch.Find(text, line.size(), k == 0 ? originIndex : 0, begin, end);
+		}
+		else
+		{
+			auto limit = k == 0 ? originIndex : line.size();
+			size_t matchBegin, matchEnd;
+			for (size_t from = 0; mSearch.Find(text, line.size(), from, matchBegin, matchEnd) && matchEnd <= limit; from = matchEnd)
+			{
+				found = true;
+				begin = matchBegin;
+				end = matchEnd;
+			}
+		}
+
+		if (found)
+		{
+			SelectFound(Coordinates(lineNo, GetCharacterColumn(lineNo, (int)begin)), Coordinates(lineNo, GetCharacterColumn(lineNo, (int)end)));
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TextEditor::Replace(const std::string& aReplacement)
+{
+	if (mReadOnly || mSearch.IsEmpty())
+		return false;
+
+	// Only a selection that is exactly a match gets replaced
+	auto replaced = false;
+	if (HasSelection() && mState.mSelectionStart.mLine == mState.mSelectionEnd.mLine)
+	{
+		auto& line = mLines[mState.mSelectionStart.mLine];
+		auto from = (size_t)GetCharacterIndex(mState.mSelectionStart);
+		auto to = (size_t)GetCharacterIndex(mState.mSelectionEnd);
+		size_t begin, end;
+		std::cmatch match;
+		if (mSearch.Find(line.mText.data(), line.size(), from, begin, end, &match) && begin == from && end == to)
+		{
+			auto text = mSearch.Format(match, aReplacement);
+
+			UndoRecord u;
+			u.mBefore = mState;
+			u.mRemoved = GetSelectedText();
+			u.mRemovedStart = mState.mSelectionStart;
+			u.mRemovedEnd = mState.mSelectionEnd;
+			DeleteSelection();
+
+			u.mAdded = text;
+			u.mAddedStart = GetActualCursorCoordinates();
+			InsertText(text);
+			u.mAddedEnd = GetInsertedEnd(u.mAddedStart, text);
+
+			u.mAfter = mState;
+			AddUndo(u);
+			replaced = true;
+		}
+	}
+
+	FindNext();
+	return replaced;
+}
+
+int TextEditor::ReplaceAll(const std::string& aReplacement)
+{
+	if (mReadOnly || mSearch.IsEmpty())
+		return 0;
+
+	// Everything from the first match to the end of the last one is removed
+	// and added back as one piece of text, which makes it a single undo step
+	int firstLine = -1, lastLine = -1;
+	size_t firstBegin = 0, lastEnd = 0;
+	size_t begin, end;
+	for (int i = 0; i < (int)mLines.size() && firstLine < 0; ++i)
+	{
+		auto& line = mLines[i];
+		if (MayHaveMatches(i) && mSearch.Find(line.mText.data(), line.size(), 0, begin, end))
+		{
+			firstLine = i;
+			firstBegin = begin;
+		}
+	}
+	if (firstLine < 0)
+		return 0;
+
+	for (int i = (int)mLines.size() - 1; i >= firstLine && lastLine < 0; --i)
+	{
+		auto& line = mLines[i];
+		if (!MayHaveMatches(i))
+			continue;
+		for (size_t from = 0; mSearch.Find(line.mText.data(), line.size(), from, begin, end); from = end)
+		{
+			lastLine = i;
+			lastEnd = end;
+		}
+	}
+
+	int count = 0;
+	std::string added;
+	std::cmatch match;
+	for (int i = firstLine; i <= lastLine; ++i)
+	{
+		auto& line = mLines[i];
+		auto text = line.mText.data();
+		auto copied = i == firstLine ? firstBegin : 0;
+		auto stop = i == lastLine ? lastEnd : line.size();
+		if (MayHaveMatches(i))
+		{
+			for (auto from = copied; mSearch.Find(text, line.size(), from, begin, end, &match) && end <= stop; from = end)
+			{
+				added.append(text + copied, begin - copied);
+				added += mSearch.Format(match, aReplacement);
+				copied = end;
+				++count;
+			}
+		}
+		added.append(text + copied, stop - copied);
+		if (i < lastLine)
+			added.push_back('\n');
+	}
+
+	Coordinates start(firstLine, GetCharacterColumn(firstLine, (int)firstBegin));
+	Coordinates finish(lastLine, GetCharacterColumn(lastLine, (int)lastEnd));
+
+	UndoRecord u;
+	u.mBefore = mState;
+	u.mRemoved = GetText(start, finish);
+	u.mRemovedStart = start;
+	u.mRemovedEnd = finish;
+	DeleteRange(start, finish);
+
+	auto pos = start;
+	InsertTextAt(pos, added.c_str());
+	pos = GetInsertedEnd(start, added);
+	u.mAdded = std::move(added);
+	u.mAddedStart = start;
+	u.mAddedEnd = pos;
+
+	SelectFound(pos, pos);
+	Colorize(start.mLine - 1, pos.mLine - start.mLine + 2);
+
+	u.mAfter = mState;
+	AddUndo(u);
+	return count;
+}
+
 const TextEditor::Palette & TextEditor::GetDarkPalette()
 {
 	const static Palette p = { {
@@ -2026,6 +2835,7 @@ const TextEditor::Palette & TextEditor::GetDarkPalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40a0a0a0, // Current line edge
+			0x6000a0ff, // Search match
 		} };
 	return p;
 }
@@ -2054,6 +2864,7 @@ const TextEditor::Palette & TextEditor::GetLightPalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40000000, // Current line edge
+			0x5000c0ff, // Search match
 		} };
 	return p;
 }
@@ -2082,6 +2893,7 @@ const TextEditor::Palette & TextEditor::GetRetroBluePalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40000000, // Current line edge
+			0x60ff00ff, // Search match
 		} };
 	return p;
 }
@@ -2089,26 +2901,63 @@ const TextEditor::Palette & TextEditor::GetRetroBluePalette()
 
 std::string TextEditor::GetText() const
 {
-	return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
+	std::string result;
+	result.reserve(GetTextSize());
+	for (auto& line : mLines)
+	{
+		result.append(line.mText);
+		result.push_back('\n');
+	}
+	return result;
 }
 
-std::vector<std::string> TextEditor::GetTextLines() const
+size_t TextEditor::GetTextSize() const
 {
-	std::vector<std::string> result;
+	size_t size = mLines.size();
+	for (auto& line : mLines)
+		size += line.size();
+	return size;
+}
 
-	result.reserve(mLines.size());
+bool TextEditor::WriteText(const TextWriter& aWriter) const
+{
+	// Short lines are gathered so aWriter sees a few large pieces rather than
+	// two calls per line; a line that fills the buffer goes out directly
+	static const size_t kWriteBufferSize = 64 * 1024;
 
-	for (auto & line : mLines)
+	std::unique_ptr<char[]> buffer(new char[kWriteBufferSize]);
+	size_t used = 0;
+	for (auto& line : mLines)
 	{
-		std::string text;
-
-		text.resize(line.size());
+		if (used + line.size() + 1 > kWriteBufferSize)
+		{
+			if (used > 0 && !aWriter(buffer.get(), used))
+				return false;
+			used = 0;
 
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
+			if (line.size() + 1 > kWriteBufferSize)
+			{
+				if (!aWriter(line.mText.data(), line.size()) || !aWriter("\n", 1))
+					return false;
+				continue;
+			}
+		}
 
-		result.emplace_back(std::move(text));
+		memcpy(buffer.get() + used, line.mText.data(), line.size());
+		used += line.size();
+		buffer[used++] = '\n';
 	}
+	return used == 0 || aWriter(buffer.get(), used);
+}
+
+std::vector<std::string> TextEditor::GetTextLines() const
+{
+	std::vector<std::string> result;
+
+	result.reserve(mLines.size());
+
+	for (auto & line : mLines)
+		result.emplace_back(line.mText);
 
 	return result;
 }
@@ -2132,117 +2981,239 @@ void TextEditor::ProcessInputs()
 
 void TextEditor::Colorize(int aFromLine, int aLines)
 {
+	++mRevision;
+
 	int toLine = aLines == -1 ? (int)mLines.size() : std::min((int)mLines.size(), aFromLine + aLines);
-	mColorRangeMin = std::min(mColorRangeMin, aFromLine);
-	mColorRangeMax = std::max(mColorRangeMax, toLine);
-	mColorRangeMin = std::max(0, mColorRangeMin);
-	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
-	mCheckComments = true;
+	AddColorRange(std::max(0, aFromLine), toLine);
+	mCommentScanMin = std::min(mCommentScanMin, std::max(0, aFromLine));
+	mCommentScanMax = std::max(mCommentScanMax, toLine);
+	mMeasureMin = std::min(mMeasureMin, std::max(0, aFromLine));
+	mMeasureMax = std::max(mMeasureMax, toLine);
+	if (!mSearch.IsEmpty())
+	{
+		mSearchMin = std::min(mSearchMin, std::max(0, aFromLine));
+		mSearchMax = std::max(mSearchMax, toLine);
+	}
 }
 
-void TextEditor::ColorizeRange(int aFromLine, int aToLine)
+void TextEditor::ColorizeLine(Line& aLine) const
 {
-	if (mLines.empty() || aFromLine >= aToLine)
-		return;
-
-	std::string buffer;
 	std::cmatch results;
 	std::string id;
 
-	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
-	for (int i = aFromLine; i < endLine; ++i)
-	{
-		auto& line = mLines[i];
+	auto& line = aLine;
+	if (line.empty())
+		return;
 
-		if (line.empty())
-			continue;
+	// Tokenize the line's bytes in place, keeping only the comment flags
+	for (auto& attributes : line.mAttributes)
+		attributes &= (Attributes)~ColorIndexMask;
+	line.mStamp = 0;
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
-		}
+	const char * bufferBegin = line.mText.data();
+	const char * bufferEnd = bufferBegin + line.size();
+
+	auto last = bufferEnd;
 
-		const char * bufferBegin = &buffer.front();
-		const char * bufferEnd = bufferBegin + buffer.size();
+	for (auto first = bufferBegin; first != last; )
+	{
+		const char * token_begin = nullptr;
+		const char * token_end = nullptr;
+		PaletteIndex token_color = PaletteIndex::Default;
 
-		auto last = bufferEnd;
+		bool hasTokenizeResult = false;
 
-		for (auto first = bufferBegin; first != last; )
+		if (mLanguageDefinition.mTokenize != nullptr)
 		{
-			const char * token_begin = nullptr;
-			const char * token_end = nullptr;
-			PaletteIndex token_color = PaletteIndex::Default;
+			if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
+				hasTokenizeResult = true;
+		}
 
-			bool hasTokenizeResult = false;
+		if (hasTokenizeResult == false && !mTokenDFA.IsEmpty())
+		{
+			int rule;
+			if (mTokenDFA.Match(first, last, token_end, rule))
+			{
+				hasTokenizeResult = true;
+				token_begin = first;
+				token_color = mLanguageDefinition.mTokenRegexStrings[rule].second;
+			}
+		}
+		else if (hasTokenizeResult == false)
+		{
+			// todo : remove
+			//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
 
-			if (mLanguageDefinition.mTokenize != nullptr)
+			for (auto& p : mRegexList)
 			{
-				if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
+				if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
+				{
 					hasTokenizeResult = true;
+
+					auto& v = *results.begin();
+					token_begin = v.first;
+					token_end = v.second;
+					token_color = p.second;
+					break;
+				}
 			}
+		}
+
+		if (hasTokenizeResult == false)
+		{
+			first++;
+		}
+		else
+		{
+			const size_t token_length = token_end - token_begin;
 
-			if (hasTokenizeResult == false)
+			if (token_color == PaletteIndex::Identifier)
 			{
-				// todo : remove
-				//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
+				id.assign(token_begin, token_end);
 
-				for (auto& p : mRegexList)
+				// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
+				if (!mLanguageDefinition.mCaseSensitive)
+					std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+
+				if (!line.HasFlag(first - bufferBegin, PreprocessorFlag))
 				{
-					if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-					{
-						hasTokenizeResult = true;
+					if (mLanguageDefinition.mKeywords.count(id) != 0)
+						token_color = PaletteIndex::Keyword;
+					else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::KnownIdentifier;
+					else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
+				}
+				else
+				{
+					if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
+				}
+			}
 
-						auto& v = *results.begin();
-						token_begin = v.first;
-						token_end = v.second;
-						token_color = p.second;
-						break;
-					}
+			for (size_t j = 0; j < token_length; ++j)
+				line.SetColorIndex((token_begin - bufferBegin) + j, token_color);
+
+			first = token_end;
+		}
+	}
+}
+
+TextEditor::CommentState TextEditor::ScanComments(Line& aLine, CommentState aState) const
+{
+	// Index where a multi-line comment opened on this line, -1 if one was
+	// already open at its start, INT_MAX outside of one
+	auto commentStartIndex = (aState & InMultiLineComment) ? -1 : std::numeric_limits<int>::max();
+	auto withinString = (aState & InString) != 0;
+	auto withinSingleLineComment = (aState & InSingleLineComment) != 0;
+	auto withinPreproc = (aState & InPreprocessor) != 0;
+	auto firstChar = (aState & AtFirstChar) != 0;	// there is no other non-whitespace characters in the line before
+	auto concatenate = (aState & Concatenate) != 0;	// '\' on the very end of the previous line
+
+	if (!concatenate)
+	{
+		withinSingleLineComment = false;
+		withinPreproc = false;
+		firstChar = true;
+	}
+	concatenate = false;
+
+	auto& line = aLine;
+	for (int currentIndex = 0; currentIndex < (int)line.size(); )
+	{
+		auto c = line.GetChar(currentIndex);
+
+		if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+			firstChar = false;
+
+		concatenate = currentIndex == (int)line.size() - 1 && c == '\\';
+
+		bool inComment = commentStartIndex <= currentIndex;
+
+		if (withinString)
+		{
+			line.SetFlag(currentIndex, MultiLineCommentFlag, inComment);
+
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < (int)line.size() && line.GetChar(currentIndex + 1) == '\"')
+				{
+					currentIndex += 1;
+					if (currentIndex < (int)line.size())
+						line.SetFlag(currentIndex, MultiLineCommentFlag, inComment);
 				}
+				else
+					withinString = false;
+			}
+			else if (c == '\\')
+			{
+				currentIndex += 1;
+				if (currentIndex < (int)line.size())
+					line.SetFlag(currentIndex, MultiLineCommentFlag, inComment);
 			}
+		}
+		else
+		{
+			if (firstChar && c == mLanguageDefinition.mPreprocChar)
+				withinPreproc = true;
 
-			if (hasTokenizeResult == false)
+			if (c == '\"')
 			{
-				first++;
+				withinString = true;
+				line.SetFlag(currentIndex, MultiLineCommentFlag, inComment);
 			}
 			else
 			{
-				const size_t token_length = token_end - token_begin;
-
-				if (token_color == PaletteIndex::Identifier)
+				auto pred = [](const char& a, const char& b) { return a == b; };
+				auto from = line.mText.begin() + currentIndex;
+				auto& startStr = mLanguageDefinition.mCommentStart;
+				auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
+
+				if (singleStartStr.size() > 0 &&
+					currentIndex + singleStartStr.size() <= line.size() &&
+					equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
 				{
-					id.assign(token_begin, token_end);
-
-					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!mLanguageDefinition.mCaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
-
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
+					withinSingleLineComment = true;
 				}
+				else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
+					equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+				{
+					commentStartIndex = currentIndex;
+				}
+
+				inComment = commentStartIndex <= currentIndex;
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+				line.SetFlag(currentIndex, MultiLineCommentFlag, inComment);
+				line.SetFlag(currentIndex, CommentFlag, withinSingleLineComment);
 
-				first = token_end;
+				auto& endStr = mLanguageDefinition.mCommentEnd;
+				if (currentIndex + 1 >= (int)endStr.size() &&
+					equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
+				{
+					commentStartIndex = std::numeric_limits<int>::max();
+				}
 			}
 		}
+		// an escape at the end of a string can step past the last byte
+		if (currentIndex < (int)line.size())
+			line.SetFlag(currentIndex, PreprocessorFlag, withinPreproc);
+		currentIndex += UTF8CharLength(c);
 	}
+
+	CommentState state = 0;
+	if (commentStartIndex != std::numeric_limits<int>::max())
+		state |= InMultiLineComment;
+	if (withinString)
+		state |= InString;
+	if (withinSingleLineComment)
+		state |= InSingleLineComment;
+	if (withinPreproc)
+		state |= InPreprocessor;
+	if (firstChar)
+		state |= AtFirstChar;
+	if (concatenate)
+		state |= Concatenate;
+	return state;
 }
 
 void TextEditor::ColorizeInternal()
@@ -2250,171 +3221,254 @@ void TextEditor::ColorizeInternal()
 	if (mLines.empty() || !mColorizerEnabled)
 		return;
 
-	if (mCheckComments)
-	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
+	if (mCommentScanMin < mCommentScanMax)
+	{
+		// Re-scan the edited lines, then carry on only while the state handed
+		// to the next line differs from the one it was last scanned with. The
+		// line before the range is clean and tells us the state to start from.
+		auto endLine = (int)mLines.size();
+		auto currentLine = std::max(0, std::min(mCommentScanMin, endLine) - 1);
+		CommentState state = currentLine == 0 ? (CommentState)AtFirstChar : mLines[currentLine].mCommentState;
+		for (; currentLine < endLine; ++currentLine)
 		{
 			auto& line = mLines[currentLine];
+			if (currentLine >= mCommentScanMax && line.mCommentState == state)
+				break;
 
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
+			line.mCommentState = state;
+			state = ScanComments(line, state);
+		}
 
-			concatenate = false;
+		mCommentScanMin = std::numeric_limits<int>::max();
+		mCommentScanMax = 0;
+	}
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
+	if (mColorizeBusy)
+		ApplyColorizeResult();
 
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
+	RemoveColorRange((int)mLines.size(), std::numeric_limits<int>::max());
+	if (mColorRanges.empty())
+		return;
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
+	// Lines on screen are coloured here and now, wherever the view is. So is
+	// a handful of edited lines, which never paints uncoloured for a frame
+	// and is cheaper than a round-trip through the worker.
+	int pending = 0;
+	for (auto& range : mColorRanges)
+		pending += range.second - range.first;
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	auto inlineFrom = mFirstVisibleLine;
+	auto inlineTo = mLastVisibleLine + 1;
+	if (pending <= kInlineColorizeLines)
+	{
+		inlineFrom = 0;
+		inlineTo = (int)mLines.size();
+	}
 
-				if (withinString)
-				{
-					line[currentIndex].mMultiLineComment = inComment;
+	for (auto it = mColorRanges.begin(); it != mColorRanges.end() && it->first < inlineTo; ++it)
+	{
+		for (int i = std::max(it->first, inlineFrom); i < std::min(it->second, inlineTo); ++i)
+			ColorizeLine(mLines[i]);
+	}
+	RemoveColorRange(inlineFrom, inlineTo);
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
-				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+	// The rest goes to the worker a chunk at a time, nearest to the view first
+	int from, to;
+	const int increment = (mLanguageDefinition.mTokenize == nullptr && mTokenDFA.IsEmpty()) ? 1000 : 10000;
+	if (!mColorizeBusy && FindColorizeChunk(increment, from, to))
+	{
+		RemoveColorRange(from, to);
+		PostColorizeJob(from, to);
+	}
+}
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+void TextEditor::AddColorRange(int aFromLine, int aToLine)
+{
+	if (aFromLine >= aToLine)
+		return;
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	// Swallow every range this one overlaps or touches
+	auto it = mColorRanges.upper_bound(aFromLine);
+	if (it != mColorRanges.begin() && std::prev(it)->second >= aFromLine)
+		--it;
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+	while (it != mColorRanges.end() && it->first <= aToLine)
+	{
+		aFromLine = std::min(aFromLine, it->first);
+		aToLine = std::max(aToLine, it->second);
+		it = mColorRanges.erase(it);
+	}
+	mColorRanges.emplace(aFromLine, aToLine);
+}
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
-				{
-					currentIndex = 0;
-					++currentLine;
-				}
-			}
-			else
-			{
-				currentIndex = 0;
-				++currentLine;
-			}
+void TextEditor::RemoveColorRange(int aFromLine, int aToLine)
+{
+	if (aFromLine >= aToLine)
+		return;
+
+	auto it = mColorRanges.upper_bound(aFromLine);
+	if (it != mColorRanges.begin() && std::prev(it)->second > aFromLine)
+		--it;
+
+	while (it != mColorRanges.end() && it->first < aToLine)
+	{
+		auto first = it->first;
+		auto last = it->second;
+		it = mColorRanges.erase(it);
+
+		// Keep whatever sticks out on either side
+		if (first < aFromLine)
+			mColorRanges.emplace(first, aFromLine);
+		if (last > aToLine)
+			mColorRanges.emplace(aToLine, last);
+	}
+}
+
+bool TextEditor::FindColorizeChunk(int aMaxLines, int& aFromLine, int& aToLine) const
+{
+	if (mColorRanges.empty())
+		return false;
+
+	// Only the ranges either side of the view can be nearest to it: the
+	// first one starting below its top, and the one before that
+	auto below = mColorRanges.lower_bound(mFirstVisibleLine);
+	auto bestDistance = std::numeric_limits<int>::max();
+
+	if (below != mColorRanges.end())
+	{
+		aFromLine = below->first;
+		aToLine = std::min(below->second, below->first + aMaxLines);
+		bestDistance = std::max(0, below->first - mLastVisibleLine);
+	}
+
+	if (below != mColorRanges.begin())
+	{
+		auto above = std::prev(below);
+		if (above->second > mFirstVisibleLine)
+		{
+			// Runs into the view, colour downwards from its top
+			aFromLine = mFirstVisibleLine;
+			aToLine = std::min(above->second, mFirstVisibleLine + aMaxLines);
+		}
+		else if (mFirstVisibleLine - above->second < bestDistance)
+		{
+			// Colour upwards, towards the start of the file
+			aFromLine = std::max(above->first, above->second - aMaxLines);
+			aToLine = above->second;
 		}
-		mCheckComments = false;
 	}
+	return true;
+}
+
+void TextEditor::PostColorizeJob(int aFromLine, int aToLine)
+{
+	auto job = std::make_unique<ColorizeJob>();
+	job->mRevision = mRevision;
+	job->mFromLine = aFromLine;
+	job->mLines.reserve(aToLine - aFromLine);
+	for (int i = aFromLine; i < aToLine; ++i)
+		job->mLines.push_back(mLines[i]);
 
-	if (mColorRangeMin < mColorRangeMax)
 	{
-		const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-		ColorizeRange(mColorRangeMin, to);
-		mColorRangeMin = to;
+		std::lock_guard<std::mutex> lock(mColorizeMutex);
+		mColorizeJob = std::move(job);
+	}
+	mColorizeCondition.notify_all();
+
+	mColorizeBusy = true;
+	mColorizeJobMin = aFromLine;
+	mColorizeJobMax = aToLine;
 
-		if (mColorRangeMax == mColorRangeMin)
+	if (!mColorizeThread.joinable())
+		mColorizeThread = std::thread(&TextEditor::ColorizeWorker, this);
+}
+
+void TextEditor::ApplyColorizeResult()
+{
+	std::unique_ptr<ColorizeJob> result;
+	{
+		std::lock_guard<std::mutex> lock(mColorizeMutex);
+		result = std::move(mColorizeResult);
+	}
+	if (result == nullptr)
+		return;
+
+	mColorizeBusy = false;
+
+	if (result->mRevision == mRevision)
+	{
+		// Nothing changed since the snapshot, so only the colour bits need
+		// copying back; the comment flags may have been rescanned meanwhile
+		auto count = std::min(result->mLines.size(), mLines.size() - result->mFromLine);
+		for (size_t i = 0; i < count; ++i)
 		{
-			mColorRangeMin = std::numeric_limits<int>::max();
-			mColorRangeMax = 0;
+			auto& src = result->mLines[i].mAttributes;
+			auto& dst = mLines[result->mFromLine + i].mAttributes;
+			if (src.size() != dst.size())
+				continue;
+			auto& line = mLines[result->mFromLine + i];
+			for (size_t j = 0; j < dst.size(); ++j)
+				line.SetAttributes(j, (Attributes)((dst[j] & ~ColorIndexMask) | (src[j] & ColorIndexMask)));
 		}
+	}
+	else if (mColorizeJobMin < mColorizeJobMax)
+	{
+		// Stale: colour whatever is on those lines now
+		AddColorRange(mColorizeJobMin, mColorizeJobMax);
+	}
+
+	mColorizeJobMin = mColorizeJobMax = 0;
+}
+
+void TextEditor::CancelColorizeJob()
+{
+	if (!mColorizeBusy)
 		return;
+
+	{
+		std::unique_lock<std::mutex> lock(mColorizeMutex);
+		mColorizeCancel = true;
+		mColorizeCondition.wait(lock, [this] { return mColorizeResult != nullptr; });
+		mColorizeCancel = false;
 	}
+
+	// A cancelled job is partly coloured, so never apply it
+	++mRevision;
+	ApplyColorizeResult();
 }
 
-float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
+void TextEditor::ColorizeWorker()
 {
-	auto& line = mLines[aFrom.mLine];
-	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-	int colIndex = GetCharacterIndex(aFrom);
-	for (size_t it = 0u; it < line.size() && it < colIndex; )
+	std::unique_lock<std::mutex> lock(mColorizeMutex);
+	for (;;)
 	{
-		if (line[it].mChar == '\t')
+		mColorizeCondition.wait(lock, [this] { return mColorizeQuit || mColorizeJob != nullptr; });
+		if (mColorizeQuit)
+			return;
+
+		auto job = std::move(mColorizeJob);
+		lock.unlock();
+
+		for (auto& line : job->mLines)
 		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-			++it;
+			if (mColorizeCancel)
+				break;
+			ColorizeLine(line);
 		}
-		else
-		{
-			auto d = UTF8CharLength(line[it].mChar);
-			char tempCString[7];
-			int i = 0;
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].mChar;
 
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
-		}
+		lock.lock();
+		mColorizeResult = std::move(job);
+		mColorizeCondition.notify_all();
 	}
+}
 
-	return distance;
+float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
+{
+	// The first byte at or past the column, as GetCharacterIndex would find it
+	auto& layout = GetLineOffsets(mLines[aFrom.mLine]);
+	auto it = std::lower_bound(layout.mColumns.begin(), layout.mColumns.end(), aFrom.mColumn);
+	auto index = std::min((size_t)(it - layout.mColumns.begin()), layout.mOffsets.size() - 1);
+	return layout.mOffsets[index];
 }
 
 void TextEditor::EnsureCursorVisible()
@@ -2422,6 +3476,7 @@ void TextEditor::EnsureCursorVisible()
 	if (!mWithinRender)
 	{
 		mScrollToCursor = true;
+		mScrollKeepFocus = false;
 		return;
 	}
 
@@ -2478,7 +3533,12 @@ TextEditor::UndoRecord::UndoRecord(
 	assert(mRemovedStart <= mRemovedEnd);
 }
 
-void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
+size_t TextEditor::UndoStep::GetMemory() const
+{
+	return sizeof(UndoStep) + (mAdded.empty() ? 0 : mAdded.mLength + 1) + (mRemoved.empty() ? 0 : mRemoved.mLength + 1);
+}
+
+void TextEditor::UndoStep::Undo(TextEditor * aEditor)
 {
 	if (!mAdded.empty())
 	{
@@ -2489,7 +3549,7 @@ void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 	if (!mRemoved.empty())
 	{
 		auto start = mRemovedStart;
-		aEditor->InsertTextAt(start, mRemoved.c_str());
+		aEditor->InsertTextAt(start, aEditor->mUndoText.Get(mRemoved));
 		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
 	}
 
@@ -2498,19 +3558,19 @@ void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 
 }
 
-void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
+void TextEditor::UndoStep::Redo(TextEditor * aEditor)
 {
 	if (!mRemoved.empty())
 	{
 		aEditor->DeleteRange(mRemovedStart, mRemovedEnd);
-		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 1);
+		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
 	}
 
 	if (!mAdded.empty())
 	{
 		auto start = mAddedStart;
-		aEditor->InsertTextAt(start, mAdded.c_str());
-		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 1);
+		aEditor->InsertTextAt(start, aEditor->mUndoText.Get(mAdded));
+		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 2);
 	}
 
 	aEditor->mState = mAfter;
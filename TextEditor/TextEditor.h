@@ -7,8 +7,18 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
+#include <deque>
 #include <regex>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "imgui.h"
+#include "BlockVector.h"
+#include "TokenDFA.h"
+#include "UndoText.h"
+#include "TextSearch.h"
 
 class TextEditor
 {
@@ -36,6 +46,7 @@ public:
 		CurrentLineFill,
 		CurrentLineFillInactive,
 		CurrentLineEdge,
+		SearchMatch,
 		Max
 	};
 
@@ -133,20 +144,103 @@ public:
 	typedef std::array<ImU32, (unsigned)PaletteIndex::Max> Palette;
 	typedef uint8_t Char;
 
-	struct Glyph
+	// Highlight state of one text byte: the palette index in the low five
+	// bits and the comment / preprocessor flags above it
+	typedef uint8_t Attributes;
+	enum AttributeFlags : Attributes
 	{
-		Char mChar;
-		PaletteIndex mColorIndex = PaletteIndex::Default;
-		bool mComment : 1;
-		bool mMultiLineComment : 1;
-		bool mPreprocessor : 1;
-
-		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex),
-			mComment(false), mMultiLineComment(false), mPreprocessor(false) {}
+		ColorIndexMask = 0x1f,
+		CommentFlag = 0x20,
+		MultiLineCommentFlag = 0x40,
+		PreprocessorFlag = 0x80
 	};
+	static_assert((unsigned)PaletteIndex::Max <= ColorIndexMask + 1, "palette index does not fit the attribute bits");
 
-	typedef std::vector<Glyph> Line;
-	typedef std::vector<Line> Lines;
+	// Comment / string / preprocessor scanner state carried from the end of
+	// one line into the start of the next
+	typedef uint8_t CommentState;
+	enum CommentStateFlags : CommentState
+	{
+		InMultiLineComment = 0x01,
+		InString = 0x02,
+		InSingleLineComment = 0x04,
+		InPreprocessor = 0x08,
+		AtFirstChar = 0x10,
+		Concatenate = 0x20
+	};
+
+	// One line of text. The UTF-8 bytes are kept contiguous so they can be
+	// tokenized, measured and drawn in place, with a parallel array holding
+	// one attribute byte per text byte.
+	struct Line
+	{
+		std::string mText;
+		std::vector<Attributes> mAttributes;
+		CommentState mCommentState = AtFirstChar;	// scanner state at the start of the line
+		mutable uint32_t mStamp = 0;				// names the cached layout, 0 once the line changes
+		float mWidth = -1.0f;						// width counted in mLineWidths, negative if not measured
+		int mMatches = -1;							// search matches counted in mSearchMatchCount, negative if not counted
+		bool mSearchSkipped = false;				// too long for the regex, counted in mSearchSkippedLines
+
+		size_t size() const { return mText.size(); }
+		bool empty() const { return mText.empty(); }
+
+		Char GetChar(size_t aIndex) const { return (Char)mText[aIndex]; }
+		PaletteIndex GetColorIndex(size_t aIndex) const { return (PaletteIndex)(mAttributes[aIndex] & ColorIndexMask); }
+		void SetColorIndex(size_t aIndex, PaletteIndex aValue)
+		{
+			SetAttributes(aIndex, (Attributes)((mAttributes[aIndex] & ~ColorIndexMask) | (Attributes)aValue));
+		}
+		bool HasFlag(size_t aIndex, Attributes aFlag) const { return (mAttributes[aIndex] & aFlag) != 0; }
+		void SetFlag(size_t aIndex, Attributes aFlag, bool aValue)
+		{
+			SetAttributes(aIndex, (Attributes)(aValue ? (mAttributes[aIndex] | aFlag) : (mAttributes[aIndex] & ~aFlag)));
+		}
+		void SetAttributes(size_t aIndex, Attributes aValue)
+		{
+			if (mAttributes[aIndex] != aValue)
+			{
+				mAttributes[aIndex] = aValue;
+				mStamp = 0;
+			}
+		}
+
+		// Inserts plain text, which starts out in the default colour
+		void Insert(size_t aAt, const char* aText, size_t aLength)
+		{
+			mText.insert(aAt, aText, aLength);
+			mAttributes.insert(mAttributes.begin() + aAt, aLength, (Attributes)PaletteIndex::Default);
+			mStamp = 0;
+		}
+
+		// Inserts bytes [aBegin, aEnd) of another line, keeping their attributes
+		void Insert(size_t aAt, const Line& aOther, size_t aBegin, size_t aEnd)
+		{
+			mText.insert(aAt, aOther.mText, aBegin, aEnd - aBegin);
+			mAttributes.insert(mAttributes.begin() + aAt, aOther.mAttributes.begin() + aBegin, aOther.mAttributes.begin() + aEnd);
+			mStamp = 0;
+		}
+
+		void Append(const Line& aOther, size_t aBegin = 0)
+		{
+			Insert(size(), aOther, aBegin, aOther.size());
+		}
+
+		void Erase(size_t aBegin, size_t aEnd)
+		{
+			mText.erase(aBegin, aEnd - aBegin);
+			mAttributes.erase(mAttributes.begin() + aBegin, mAttributes.begin() + aEnd);
+			mStamp = 0;
+		}
+
+		void Reserve(size_t aSize)
+		{
+			mText.reserve(aSize);
+			mAttributes.reserve(aSize);
+		}
+	};
+
+	typedef BlockVector<Line> Lines;
 
 	struct LanguageDefinition
 	{
@@ -196,8 +290,75 @@ public:
 
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
 	void SetText(const std::string& aText);
+	// aText need not be null-terminated, e.g. a memory-mapped file
+	void SetText(const char* aText, size_t aLength);
+
+	// Called with the fraction done, return false to abandon the work
+	typedef std::function<bool(float)> ProgressCallback;
+
+	// Splits text into lines without touching any editor state, so it can
+	// run on a worker thread; the result is handed over with SetLines().
+	// Returns no lines when aProgress cancels.
+	static Lines BuildLines(const char* aText, size_t aLength, const ProgressCallback& aProgress = ProgressCallback());
+	void SetLines(Lines&& aLines);
 	std::string GetText() const;
 
+	// Size in bytes of what GetText() returns
+	size_t GetTextSize() const;
+
+	// Hands the same bytes GetText() returns to aWriter in pieces of up to
+	// 64 KiB (longer lines on their own), so the text can be written out
+	// without building it in one string. Stops early and returns false as
+	// soon as aWriter does.
+	typedef std::function<bool(const char* aData, size_t aSize)> TextWriter;
+	bool WriteText(const TextWriter& aWriter) const;
+
+	// The bytes of one line as stored, without its newline. Only valid
+	// until the text is next changed.
+	struct LineSpan
+	{
+		const char* mData;
+		size_t mSize;
+	};
+
+	// Iterates the lines in place, e.g. to write them straight to a file:
+	//   for (auto span : editor.GetLineSpans()) { write(span); write("\n"); }
+	class LineSpans
+	{
+	public:
+		class Iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef LineSpan value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const LineSpan* pointer;
+			typedef LineSpan reference;
+
+			explicit Iterator(Lines::const_iterator aIt) : mIt(aIt) {}
+
+			LineSpan operator*() const { return LineSpan{ mIt->mText.data(), mIt->size() }; }
+			Iterator& operator++() { ++mIt; return *this; }
+			Iterator operator++(int) { Iterator tmp = *this; ++mIt; return tmp; }
+			bool operator==(const Iterator& o) const { return mIt == o.mIt; }
+			bool operator!=(const Iterator& o) const { return mIt != o.mIt; }
+
+		private:
+			Lines::const_iterator mIt;
+		};
+
+		explicit LineSpans(const Lines& aLines) : mLines(aLines) {}
+
+		Iterator begin() const { return Iterator(mLines.begin()); }
+		Iterator end() const { return Iterator(mLines.end()); }
+		size_t size() const { return mLines.size(); }
+
+	private:
+		const Lines& mLines;
+	};
+
+	LineSpans GetLineSpans() const { return LineSpans(mLines); }
+
 	void SetTextLines(const std::vector<std::string>& aLines);
 	std::vector<std::string> GetTextLines() const;
 
@@ -233,6 +394,11 @@ public:
 	void SetTabSize(int aValue);
 	inline int GetTabSize() const { return mTabSize; }
 
+	// Oldest undo steps are dropped once the history holds more than this
+	// many bytes; the latest step is always kept
+	void SetUndoMemoryLimit(size_t aValue);
+	inline size_t GetUndoMemoryLimit() const { return mUndoMemoryLimit; }
+
 	void InsertText(const std::string& aValue);
 	void InsertText(const char* aValue);
 
@@ -262,6 +428,28 @@ public:
 	void Undo(int aSteps = 1);
 	void Redo(int aSteps = 1);
 
+	// Find and replace. Matches never span lines. How many each line holds is
+	// kept up to date as the text changes, a bounded amount of text per
+	// frame, so navigation skips lines without matches. A bad regex clears
+	// the search and returns false, see GetSearchError().
+	bool SetSearch(const std::string& aQuery, bool aRegex = false, bool aCaseSensitive = true);
+	void ClearSearch();
+	const std::string& GetSearchError() const { return mSearchError; }
+	// Matches in the lines counted so far, final once no longer pending
+	int GetSearchMatchCount() const { return mSearchMatchCount; }
+	// Lines among those counted that were too long for a regex to search,
+	// see TextSearch::kMaxRegexLineLength
+	int GetSearchSkippedLines() const { return mSearchSkippedLines; }
+	bool IsSearchPending() const { return mSearchMin < mSearchMax; }
+
+	// Selects the next match after the selection (or the one before it),
+	// wrapping around the end of the text
+	bool FindNext(bool aBackwards = false);
+	// Replaces the selection if it is a match and moves on to the next one
+	bool Replace(const std::string& aReplacement);
+	// Replaces every match as a single undo step, returns how many
+	int ReplaceAll(const std::string& aReplacement);
+
 	static const Palette& GetDarkPalette();
 	static const Palette& GetLightPalette();
 	static const Palette& GetRetroBluePalette();
@@ -276,6 +464,7 @@ private:
 		Coordinates mCursorPosition;
 	};
 
+	// An edit as it is being made; AddUndo moves its text into mUndoText
 	class UndoRecord
 	{
 	public:
@@ -294,14 +483,32 @@ private:
 			TextEditor::EditorState& aBefore,
 			TextEditor::EditorState& aAfter);
 
+		std::string mAdded;
+		Coordinates mAddedStart;
+		Coordinates mAddedEnd;
+
+		std::string mRemoved;
+		Coordinates mRemovedStart;
+		Coordinates mRemovedEnd;
+
+		EditorState mBefore;
+		EditorState mAfter;
+	};
+
+	// An edit as it is kept in the history
+	class UndoStep
+	{
+	public:
 		void Undo(TextEditor* aEditor);
 		void Redo(TextEditor* aEditor);
 
-		std::string mAdded;
+		size_t GetMemory() const;
+
+		UndoText::Span mAdded;
 		Coordinates mAddedStart;
 		Coordinates mAddedEnd;
 
-		std::string mRemoved;
+		UndoText::Span mRemoved;
 		Coordinates mRemovedStart;
 		Coordinates mRemovedEnd;
 
@@ -309,12 +516,74 @@ private:
 		EditorState mAfter;
 	};
 
-	typedef std::vector<UndoRecord> UndoBuffer;
+	typedef std::deque<UndoStep> UndoBuffer;
+
+	// A copy of some lines handed to the colorizer thread, tagged with the
+	// buffer revision it was taken from
+	struct ColorizeJob
+	{
+		uint64_t mRevision = 0;
+		int mFromLine = 0;
+		std::vector<Line> mLines;
+	};
+
+	// A piece of a line drawn in one call: bytes [mBegin, mEnd) from mX to
+	// mEndX past the line start. A lone space or tab is a whitespace marker.
+	struct DrawRun
+	{
+		int mBegin, mEnd;
+		float mX, mEndX;
+		ImU32 mColor;
+	};
+
+	// What is remembered about a line's layout until it changes. The x offset
+	// and column at each byte index are filled in on the first query that
+	// needs them; the bytes after a UTF-8 lead byte hold the values past the
+	// whole character.
+	struct LineLayout
+	{
+		std::vector<DrawRun> mRuns;
+		std::vector<float> mOffsets;
+		std::vector<int> mColumns;
+		bool mHasRuns = false;
+		int mLastFrame = 0;
+	};
+
+	// Everything besides the line itself that decides how its runs come out
+	struct DrawRunsKey
+	{
+		Palette mPalette = {};
+		ImFont* mFont = nullptr;
+		float mFontSize = 0.0f;
+		int mTabSize = 0;
+		bool mColorizerEnabled = false;
+
+		bool operator==(const DrawRunsKey&) const = default;
+	};
+
+	// Pending ranges up to this many lines are colorized on the UI thread
+	static const int kInlineColorizeLines = 32;
+	// Lines measured per frame for the document-wide longest line
+	static const int kMeasureLinesPerFrame = 2000;
+
+	static const size_t kDefaultUndoMemoryLimit = 64 * 1024 * 1024;
+
+	// Text searched per frame to count matches after an edit or a new query
+	static const size_t kSearchBytesPerFrame = 4 * 1024 * 1024;
+	static const size_t kRegexSearchBytesPerFrame = 256 * 1024;
 
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
-	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
+	void ColorizeLine(Line& aLine) const;
 	void ColorizeInternal();
+	void AddColorRange(int aFromLine, int aToLine);
+	void RemoveColorRange(int aFromLine, int aToLine);
+	bool FindColorizeChunk(int aMaxLines, int& aFromLine, int& aToLine) const;
+	void PostColorizeJob(int aFromLine, int aToLine);
+	void ApplyColorizeResult();
+	void CancelColorizeJob();
+	void ColorizeWorker();
+	CommentState ScanComments(Line& aLine, CommentState aState) const;
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -325,6 +594,10 @@ private:
 	void DeleteRange(const Coordinates& aStart, const Coordinates& aEnd);
 	int InsertTextAt(Coordinates& aWhere, const char* aValue);
 	void AddUndo(UndoRecord& aValue);
+	bool MergeUndo(const UndoRecord& aValue);
+	void DropUndoSteps(size_t aFirst, size_t aLast);
+	void LimitUndoMemory();
+	void ClearUndo();
 	Coordinates ScreenPosToCoordinates(const ImVec2& aPosition) const;
 	Coordinates FindWordStart(const Coordinates& aFrom) const;
 	Coordinates FindWordEnd(const Coordinates& aFrom) const;
@@ -337,12 +610,27 @@ private:
 	void RemoveLine(int aStart, int aEnd);
 	void RemoveLine(int aIndex);
 	Line& InsertLine(int aIndex);
+	void ShiftPendingScans(int aIndex, int aDelta);
+	void InsertLines(int aIndex, std::vector<Line>&& aLines);
 	void EnterCharacter(ImWchar aChar, bool aShift);
 	void Backspace();
 	void DeleteSelection();
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
-	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	ImU32 GetGlyphColor(Attributes aAttributes) const;
+	LineLayout& GetLineLayout(const Line& aLine) const;
+	const std::vector<DrawRun>& GetDrawRuns(const Line& aLine) const;
+	const LineLayout& GetLineOffsets(const Line& aLine) const;
+	void BuildDrawRuns(const Line& aLine, std::vector<DrawRun>& aRuns) const;
+	void BuildLineOffsets(const Line& aLine, LineLayout& aLayout) const;
+	float MeasureLine(const Line& aLine) const;
+	void MeasureLines();
+	void ForgetLineWidth(Line& aLine);
+	void IndexSearch();
+	void ForgetLineMatches(Line& aLine);
+	bool MayHaveMatches(int aLine) const;
+	void SelectFound(const Coordinates& aStart, const Coordinates& aEnd);
+	Coordinates GetInsertedEnd(const Coordinates& aStart, const std::string& aText) const;
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
@@ -353,6 +641,9 @@ private:
 	EditorState mState;
 	UndoBuffer mUndoBuffer;
 	int mUndoIndex;
+	UndoText mUndoText;
+	size_t mUndoMemory;				// bytes held by mUndoBuffer, text included
+	size_t mUndoMemoryLimit;
 
 	int mTabSize;
 	bool mOverwrite;
@@ -365,7 +656,8 @@ private:
 	float mTextStart;                   // position (in pixels) where a code line starts relative to the left of the TextEditor.
 	int  mLeftMargin;
 	bool mCursorPositionChanged;
-	int mColorRangeMin, mColorRangeMax;
+	std::map<int, int> mColorRanges;	// lines waiting for token colours, first -> last + 1
+	int mFirstVisibleLine, mLastVisibleLine;
 	SelectionMode mSelectionMode;
 	bool mHandleKeyboardInputs;
 	bool mHandleMouseInputs;
@@ -376,13 +668,41 @@ private:
 	Palette mPalette;
 	LanguageDefinition mLanguageDefinition;
 	RegexList mRegexList;
+	TokenDFA mTokenDFA;
+
+	int mCommentScanMin, mCommentScanMax;
+	int mMeasureMin, mMeasureMax;		// lines whose width may have changed
+	std::map<float, int> mLineWidths;	// how many measured lines have each width
+
+	TextSearch mSearch;
+	std::string mSearchError;
+	int mSearchMin, mSearchMax;			// lines whose matches may have changed
+	int mSearchMatchCount;
+	int mSearchSkippedLines;
+	bool mScrollKeepFocus;				// scroll to the cursor without focusing the editor
+
+	mutable std::unordered_map<uint32_t, LineLayout> mLineLayouts;	// by Line::mStamp
+	DrawRunsKey mDrawRunsKey;
+	mutable uint32_t mLastStamp;
+	int mRenderFrame;
+
+	// Bumped whenever the text changes, so results computed on an older
+	// snapshot can be recognised and dropped
+	uint64_t mRevision;
+	std::thread mColorizeThread;
+	std::mutex mColorizeMutex;
+	std::condition_variable mColorizeCondition;
+	std::unique_ptr<ColorizeJob> mColorizeJob;		// waiting for the worker
+	std::unique_ptr<ColorizeJob> mColorizeResult;	// finished, waiting for the UI thread
+	std::atomic<bool> mColorizeCancel;
+	bool mColorizeQuit;
+	bool mColorizeBusy;								// a job is out and its result not yet taken
+	int mColorizeJobMin, mColorizeJobMax;			// lines the job covers, shifted with edits
 
-	bool mCheckComments;
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
 	Coordinates mInteractiveStart, mInteractiveEnd;
-	std::string mLineBuffer;
 	uint64_t mStartTime;
 
 	float mLastClick;
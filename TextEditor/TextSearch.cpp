@@ -0,0 +1,160 @@
+#include <cctype>
+#include <cstring>
+
+#include "TextSearch.h"
+
+TextSearch::TextSearch()
+	: mRegex(false)
+	, mCaseSensitive(true)
+{
+	Clear();
+}
+
+bool TextSearch::Compile(const std::string& aQuery, bool aRegex, bool aCaseSensitive, std::string& aError)
+{
+	Clear();
+	aError.clear();
+	if (aQuery.empty())
+		return true;
+
+	if (aRegex)
+	{
+		auto flags = std::regex_constants::ECMAScript | std::regex_constants::optimize;
+		if (!aCaseSensitive)
+			flags |= std::regex_constants::icase;
+		try
+		{
+			mPattern = std::regex(aQuery, flags);
+		}
+		catch (const std::regex_error& e)
+		{
+			aError = e.what();
+			return false;
+		}
+	}
+
+	mRegex = aRegex;
+	mCaseSensitive = aCaseSensitive;
+	for (int i = 0; i < 256; ++i)
+		mFold[i] = (uint8_t)(aCaseSensitive ? i : std::tolower(i));
+
+	mQuery = aQuery;
+	for (auto& c : mQuery)
+		c = (char)mFold[(uint8_t)c];
+
+	// Indexed by folded bytes; one that is not in the query (but for its last
+	// byte) lets the window jump past it entirely
+	auto length = mQuery.size();
+	for (auto& shift : mShift)
+		shift = length;
+	for (size_t i = 0; i + 1 < length; ++i)
+		mShift[(uint8_t)mQuery[i]] = length - 1 - i;
+
+	return true;
+}
+
+void TextSearch::Clear()
+{
+	mQuery.clear();
+	mRegex = false;
+	mCaseSensitive = true;
+	mPattern = std::regex();
+	for (int i = 0; i < 256; ++i)
+		mFold[i] = (uint8_t)i;
+}
+
+bool TextSearch::FindPlain(const char* aText, size_t aLength, size_t aFrom, size_t& aBegin) const
+{
+	auto length = mQuery.size();
+	if (aFrom > aLength || aLength - aFrom < length)
+		return false;
+
+	auto query = (const uint8_t*)mQuery.data();
+	auto text = (const uint8_t*)aText;
+
+	// A single byte needs no skip table, memchr finds it (and its other case)
+	if (length == 1)
+	{
+		auto size = aLength - aFrom;
+		auto found = (const uint8_t*)memchr(text + aFrom, query[0], size);
+		auto upper = (uint8_t)std::toupper(query[0]);
+		if (!mCaseSensitive && upper != query[0])
+		{
+			auto other = (const uint8_t*)memchr(text + aFrom, upper, found != nullptr ? (size_t)(found - text) - aFrom : size);
+			if (other != nullptr)
+				found = other;
+		}
+		if (found == nullptr)
+			return false;
+		aBegin = (size_t)(found - text);
+		return true;
+	}
+
+	auto last = query[length - 1];
+	for (size_t at = aFrom; at + length <= aLength; )
+	{
+		auto c = mFold[text[at + length - 1]];
+		if (c == last)
+		{
+			size_t i = 0;
+			while (i + 1 < length && mFold[text[at + i]] == query[i])
+				++i;
+			if (i + 1 == length)
+			{
+				aBegin = at;
+				return true;
+			}
+		}
+		at += mShift[c];
+	}
+	return false;
+}
+
+bool TextSearch::Find(const char* aText, size_t aLength, size_t aFrom, size_t& aBegin, size_t& aEnd, std::cmatch* aMatch) const
+{
+	if (mQuery.empty())
+		return false;
+
+	if (!mRegex)
+	{
+		if (!FindPlain(aText, aLength, aFrom, aBegin))
+			return false;
+		aEnd = aBegin + mQuery.size();
+		return true;
+	}
+
+	if (Skips(aLength))
+		return false;
+
+	std::cmatch match;
+	auto& results = aMatch != nullptr ? *aMatch : match;
+	while (aFrom <= aLength)
+	{
+		auto flags = aFrom > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+		if (!std::regex_search(aText + aFrom, aText + aLength, results, mPattern, flags))
+			return false;
+
+		aBegin = (size_t)(results[0].first - aText);
+		aEnd = (size_t)(results[0].second - aText);
+		if (aEnd > aBegin)
+			return true;
+		aFrom = aBegin + 1;
+	}
+	return false;
+}
+
+int TextSearch::Count(const char* aText, size_t aLength) const
+{
+	int count = 0;
+	size_t begin, end;
+	for (size_t from = 0; Find(aText, aLength, from, begin, end); from = end)
+		++count;
+	return count;
+}
+
+std::string TextSearch::Format(const std::cmatch& aMatch, const std::string& aReplacement) const
+{
+	if (!mRegex)
+		return aReplacement;
+	return aMatch.format(aReplacement);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+
+// Finds a query inside one line of text. Plain queries are matched with
+// Boyer-Moore-Horspool over the raw bytes, optionally folding ASCII case;
+// regex queries use std::regex (ECMAScript). Matches never span lines and
+// empty matches are skipped, so a pattern like "a*" only finds runs of a.
+class TextSearch
+{
+public:
+	// std::regex matches recursively, a stack frame or more per byte, and a
+	// pattern like "(a|b)*" overflows a 1 MB stack on a line of 2 KB; longer
+	// lines are skipped by a regex search
+	static constexpr size_t kMaxRegexLineLength = 512;
+
+	TextSearch();
+
+	// Prepares aQuery, returns false and sets aError if the regex does not
+	// compile. An empty query compiles to a search that finds nothing.
+	bool Compile(const std::string& aQuery, bool aRegex, bool aCaseSensitive, std::string& aError);
+	void Clear();
+	bool IsEmpty() const { return mQuery.empty(); }
+	bool IsRegex() const { return mRegex; }
+	// Whether Find() passes over a line of aLength bytes without looking
+	bool Skips(size_t aLength) const { return mRegex && aLength > kMaxRegexLineLength; }
+
+	// Finds the first match in aText[aFrom, aLength) as byte offsets into
+	// aText. Bytes before aFrom are still looked at by anchors and \b.
+	bool Find(const char* aText, size_t aLength, size_t aFrom, size_t& aBegin, size_t& aEnd, std::cmatch* aMatch = nullptr) const;
+	int Count(const char* aText, size_t aLength) const;
+
+	// What a match found with Find(..., aMatch) is replaced with; for a regex
+	// $&, $1... in aReplacement refer to the match
+	std::string Format(const std::cmatch& aMatch, const std::string& aReplacement) const;
+
+private:
+	bool FindPlain(const char* aText, size_t aLength, size_t aFrom, size_t& aBegin) const;
+
+	std::string mQuery;				// case folded unless mCaseSensitive
+	bool mRegex;
+	bool mCaseSensitive;
+	std::regex mPattern;
+	uint8_t mFold[256];				// byte -> byte compared, identity when case sensitive
+	size_t mShift[256];				// Horspool skip for the byte under the last query byte
+};
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <cctype>
+#include <map>
+
+#include "TokenDFA.h"
+
+namespace
+{
+	typedef std::bitset<256> CharSet;
+
+	// Thompson NFA: each node has at most one byte transition plus any number
+	// of epsilon edges, and is accepting if mRule is set
+	struct NfaNode
+	{
+		int mCharSet = -1;
+		int mCharNext = -1;
+		std::vector<int> mEpsilon;
+		int mRule = -1;
+	};
+
+	int FirstByte(const CharSet& aSet)
+	{
+		for (int b = 0; b < 256; ++b)
+			if (aSet[b])
+				return b;
+		return -1;
+	}
+
+	struct Fragment
+	{
+		int mStart, mEnd;
+	};
+
+	class NfaBuilder
+	{
+	public:
+		std::vector<NfaNode> mNodes;
+		std::vector<CharSet> mSets;
+
+		// Parses one pattern, returns false on syntax this engine does not handle
+		bool Parse(const std::string& aPattern, Fragment& aOut)
+		{
+			mPattern = &aPattern;
+			mPos = 0;
+			mOk = true;
+			aOut = ParseAlternation();
+			return mOk && mPos == aPattern.size();
+		}
+
+		int NewNode()
+		{
+			mNodes.emplace_back();
+			return (int)mNodes.size() - 1;
+		}
+
+	private:
+		bool AtEnd() const { return mPos >= mPattern->size(); }
+		char Peek() const { return (*mPattern)[mPos]; }
+
+		Fragment Fail()
+		{
+			mOk = false;
+			auto n = NewNode();
+			return { n, n };
+		}
+
+		Fragment Empty()
+		{
+			auto n = NewNode();
+			return { n, n };
+		}
+
+		Fragment Single(const CharSet& aSet)
+		{
+			auto s = NewNode();
+			auto e = NewNode();
+			mSets.push_back(aSet);
+			mNodes[s].mCharSet = (int)mSets.size() - 1;
+			mNodes[s].mCharNext = e;
+			return { s, e };
+		}
+
+		Fragment Concat(Fragment aFirst, Fragment aSecond)
+		{
+			mNodes[aFirst.mEnd].mEpsilon.push_back(aSecond.mStart);
+			return { aFirst.mStart, aSecond.mEnd };
+		}
+
+		Fragment Alternate(Fragment aFirst, Fragment aSecond)
+		{
+			auto s = NewNode();
+			auto e = NewNode();
+			mNodes[s].mEpsilon = { aFirst.mStart, aSecond.mStart };
+			mNodes[aFirst.mEnd].mEpsilon.push_back(e);
+			mNodes[aSecond.mEnd].mEpsilon.push_back(e);
+			return { s, e };
+		}
+
+		Fragment Repeat(Fragment aInner, char aQuantifier)
+		{
+			auto s = NewNode();
+			auto e = NewNode();
+			mNodes[s].mEpsilon.push_back(aInner.mStart);
+			if (aQuantifier != '+')
+				mNodes[s].mEpsilon.push_back(e);
+			mNodes[aInner.mEnd].mEpsilon.push_back(e);
+			if (aQuantifier != '?')
+				mNodes[aInner.mEnd].mEpsilon.push_back(aInner.mStart);
+			return { s, e };
+		}
+
+		Fragment ParseAlternation()
+		{
+			auto result = ParseConcatenation();
+			while (mOk && !AtEnd() && Peek() == '|')
+			{
+				++mPos;
+				result = Alternate(result, ParseConcatenation());
+			}
+			return result;
+		}
+
+		Fragment ParseConcatenation()
+		{
+			auto result = Empty();
+			while (mOk && !AtEnd() && Peek() != '|' && Peek() != ')')
+				result = Concat(result, ParseRepetition());
+			return result;
+		}
+
+		Fragment ParseRepetition()
+		{
+			auto result = ParseAtom();
+			while (mOk && !AtEnd() && (Peek() == '*' || Peek() == '+' || Peek() == '?'))
+			{
+				auto quantifier = (*mPattern)[mPos++];
+				if (!AtEnd() && Peek() == '?')
+					return Fail();	// lazy quantifier
+				result = Repeat(result, quantifier);
+			}
+			if (mOk && !AtEnd() && Peek() == '{')
+				return Fail();	// counted repetition
+			return result;
+		}
+
+		Fragment ParseAtom()
+		{
+			auto c = (*mPattern)[mPos++];
+			CharSet set;
+			switch (c)
+			{
+			case '(':
+			{
+				if (!AtEnd() && Peek() == '?')
+				{
+					if (mPos + 1 < mPattern->size() && (*mPattern)[mPos + 1] == ':')
+						mPos += 2;
+					else
+						return Fail();	// lookaround
+				}
+				auto inner = ParseAlternation();
+				if (AtEnd() || Peek() != ')')
+					return Fail();
+				++mPos;
+				return inner;
+			}
+			case '[':
+				if (!ParseClass(set))
+					return Fail();
+				return Single(set);
+			case '.':
+				set.set();
+				set.reset('\n');
+				set.reset('\r');
+				return Single(set);
+			case '\\':
+				if (AtEnd() || !ParseEscape(set, false))
+					return Fail();
+				return Single(set);
+			case '^': case '$': case '*': case '+': case '?': case '{': case '}': case ')':
+				return Fail();
+			default:
+				set.set((uint8_t)c);
+				return Single(set);
+			}
+		}
+
+		// Parses the escape after a backslash into a set of bytes
+		bool ParseEscape(CharSet& aSet, bool aInClass)
+		{
+			auto c = (*mPattern)[mPos++];
+			switch (c)
+			{
+			case 't': aSet.set('\t'); return true;
+			case 'n': aSet.set('\n'); return true;
+			case 'r': aSet.set('\r'); return true;
+			case 'f': aSet.set('\f'); return true;
+			case 'v': aSet.set('\v'); return true;
+			case '0': aSet.set(0); return true;
+			case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+			{
+				CharSet cls;
+				for (int b = 0; b < 256; ++b)
+				{
+					bool digit = b >= '0' && b <= '9';
+					bool word = digit || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_';
+					bool space = b == ' ' || (b >= '\t' && b <= '\r');
+					bool in = (c == 'd' || c == 'D') ? digit : (c == 'w' || c == 'W') ? word : space;
+					cls[b] = in;
+				}
+				if (c == 'D' || c == 'W' || c == 'S')
+					cls.flip();
+				aSet |= cls;
+				return true;
+			}
+			case 'x':
+			{
+				if (mPos + 2 > mPattern->size() || !isxdigit((uint8_t)(*mPattern)[mPos]) || !isxdigit((uint8_t)(*mPattern)[mPos + 1]))
+					return false;
+				aSet.set(std::stoi(mPattern->substr(mPos, 2), nullptr, 16));
+				mPos += 2;
+				return true;
+			}
+			case 'b':
+				if (!aInClass)
+					return false;	// word boundary assertion
+				aSet.set('\b');
+				return true;
+			default:
+				// escaped punctuation is a literal, anything else (back-references,
+				// unicode escapes, assertions) is not supported
+				if (isalnum((uint8_t)c))
+					return false;
+				aSet.set((uint8_t)c);
+				return true;
+			}
+		}
+
+		// Parses a bracket class after its '['
+		bool ParseClass(CharSet& aSet)
+		{
+			bool negate = false;
+			if (!AtEnd() && Peek() == '^')
+			{
+				negate = true;
+				++mPos;
+			}
+
+			while (!AtEnd() && Peek() != ']')
+			{
+				CharSet item;
+				int low = -1;
+				if (Peek() == '\\')
+				{
+					++mPos;
+					if (AtEnd() || !ParseEscape(item, true))
+						return false;
+					if (item.count() == 1)
+						low = FirstByte(item);
+				}
+				else if (Peek() == '[' && mPos + 1 < mPattern->size()
+					&& ((*mPattern)[mPos + 1] == ':' || (*mPattern)[mPos + 1] == '.' || (*mPattern)[mPos + 1] == '='))
+				{
+					return false;	// [:alpha:], [.a.] and [=a=] name classes std::regex resolves
+				}
+				else
+				{
+					low = (uint8_t)(*mPattern)[mPos++];
+					item.set(low);
+				}
+
+				// a range, unless the '-' is the last character of the class
+				if (low >= 0 && mPos + 1 < mPattern->size() && Peek() == '-' && (*mPattern)[mPos + 1] != ']')
+				{
+					++mPos;
+					int high;
+					if (Peek() == '\\')
+					{
+						++mPos;
+						CharSet end;
+						if (AtEnd() || !ParseEscape(end, true) || end.count() != 1)
+							return false;
+						high = FirstByte(end);
+					}
+					else
+						high = (uint8_t)(*mPattern)[mPos++];
+					if (high < low)
+						return false;
+					for (int b = low; b <= high; ++b)
+						item.set(b);
+				}
+				aSet |= item;
+			}
+
+			if (AtEnd())
+				return false;
+			++mPos;	// ']'
+
+			if (negate)
+				aSet.flip();
+			return true;
+		}
+
+		const std::string* mPattern = nullptr;
+		size_t mPos = 0;
+		bool mOk = true;
+	};
+
+	void Closure(const std::vector<NfaNode>& aNodes, std::vector<int>& aStates)
+	{
+		std::vector<bool> seen(aNodes.size());
+		std::vector<int> stack(aStates);
+		aStates.clear();
+		while (!stack.empty())
+		{
+			auto n = stack.back();
+			stack.pop_back();
+			if (seen[n])
+				continue;
+			seen[n] = true;
+			aStates.push_back(n);
+			for (auto next : aNodes[n].mEpsilon)
+				if (!seen[next])
+					stack.push_back(next);
+		}
+		std::sort(aStates.begin(), aStates.end());
+	}
+}
+
+TokenDFA::TokenDFA()
+	: mClassCount(0)
+{
+	std::fill(std::begin(mByteClass), std::end(mByteClass), (uint8_t)0);
+}
+
+void TokenDFA::Clear()
+{
+	mClassCount = 0;
+	mTransitions.clear();
+	mAccepts.clear();
+}
+
+bool TokenDFA::Compile(const std::vector<std::string>& aPatterns)
+{
+	Clear();
+	if (aPatterns.empty() || aPatterns.size() > kMaxRules)
+		return false;
+
+	NfaBuilder builder;
+	auto start = builder.NewNode();
+	for (size_t i = 0; i < aPatterns.size(); ++i)
+	{
+		Fragment fragment;
+		if (!builder.Parse(aPatterns[i], fragment))
+			return false;
+		builder.mNodes[start].mEpsilon.push_back(fragment.mStart);
+		builder.mNodes[fragment.mEnd].mRule = (int)i;
+	}
+	auto& nodes = builder.mNodes;
+
+	// Bytes that every character set treats alike share one table column
+	std::map<std::vector<bool>, int> signatures;
+	uint8_t representative[256];
+	for (int b = 0; b < 256; ++b)
+	{
+		std::vector<bool> signature(builder.mSets.size());
+		for (size_t s = 0; s < builder.mSets.size(); ++s)
+			signature[s] = builder.mSets[s][b];
+		auto it = signatures.emplace(std::move(signature), (int)signatures.size()).first;
+		mByteClass[b] = (uint8_t)it->second;
+		representative[it->second] = (uint8_t)b;
+	}
+	auto classCount = (int)signatures.size();
+
+	// Subset construction; DFA state 0 is the dead state
+	std::map<std::vector<int>, int> states;
+	std::vector<std::vector<int>> pending;
+	states.emplace(std::vector<int>(), 0);
+	pending.emplace_back();
+	std::vector<int> initial{ start };
+	Closure(nodes, initial);
+	states.emplace(initial, 1);
+	pending.push_back(initial);
+
+	mTransitions.assign(2 * classCount, 0);
+	mAccepts.assign(2, 0);
+	for (size_t current = 1; current < pending.size(); ++current)
+	{
+		auto set = pending[current];
+		for (auto n : set)
+			if (nodes[n].mRule >= 0)
+				mAccepts[current] |= uint64_t(1) << nodes[n].mRule;
+
+		for (int c = 0; c < classCount; ++c)
+		{
+			std::vector<int> next;
+			for (auto n : set)
+				if (nodes[n].mCharSet >= 0 && builder.mSets[nodes[n].mCharSet][representative[c]])
+					next.push_back(nodes[n].mCharNext);
+			if (next.empty())
+				continue;
+			Closure(nodes, next);
+
+			auto it = states.find(next);
+			if (it == states.end())
+			{
+				if (pending.size() >= kMaxStates)
+				{
+					Clear();
+					return false;
+				}
+				it = states.emplace(next, (int)pending.size()).first;
+				pending.push_back(next);
+				mTransitions.resize(pending.size() * classCount, 0);
+				mAccepts.resize(pending.size(), 0);
+			}
+			mTransitions[current * classCount + c] = (uint16_t)it->second;
+		}
+	}
+
+	mClassCount = classCount;
+	return true;
+}
+
+bool TokenDFA::Match(const char* aBegin, const char* aEnd, const char*& aTokenEnd, int& aRule) const
+{
+	if (IsEmpty())
+		return false;
+
+	// Run until every rule is dead, remembering the lowest-numbered rule that
+	// accepted and the furthest point where it did
+	int best = kMaxRules;
+	const char* bestEnd = nullptr;
+	int state = 1;
+	for (auto p = aBegin; p < aEnd; )
+	{
+		state = mTransitions[state * mClassCount + mByteClass[(uint8_t)*p++]];
+		if (state == 0)
+			break;
+
+		auto accepts = mAccepts[state];
+		if (accepts != 0)
+		{
+			auto lowest = std::countr_zero(accepts);
+			if (lowest < best)
+			{
+				best = lowest;
+				bestEnd = p;
+			}
+			else if (accepts & (uint64_t(1) << best))
+				bestEnd = p;
+		}
+	}
+
+	if (bestEnd == nullptr)
+		return false;
+
+	aTokenEnd = bestEnd;
+	aRule = best;
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compiles an ordered list of token regexes into one table-driven DFA, so a
+// token is found in a single pass over its bytes instead of one regex search
+// per rule. The first rule that matches at all wins, as when the rules are
+// tried in order with std::regex_search(match_continuous), but it takes the
+// longest match the rule can make. ECMAScript takes the first alternative
+// that matches instead ("a|ab" on "ab" gives "a"), so the two only agree
+// for patterns where no alternative or repetition can stop early. That is
+// checked for the built-in language definitions only, token by token
+// against std::regex. Other patterns may colour differently.
+//
+// Supported syntax: literals, '.', escapes (\t \n \r \f \v \0 \d \D \w \W
+// \s \S and escaped punctuation), bracket classes with ranges and negation,
+// groups including (?:...), '|', and the greedy quantifiers '*', '+', '?'.
+// Anything else (anchors, counted repetition, lazy quantifiers, lookaround,
+// back-references) makes Compile() fail so the caller can keep std::regex.
+class TokenDFA
+{
+public:
+	TokenDFA();
+
+	// Builds the automaton, returns false if a pattern is not supported or the
+	// automaton would grow too large
+	bool Compile(const std::vector<std::string>& aPatterns);
+	void Clear();
+	bool IsEmpty() const { return mClassCount == 0; }
+
+	// Matches a token starting exactly at aBegin. On success sets aTokenEnd and
+	// the index of the winning pattern.
+	bool Match(const char* aBegin, const char* aEnd, const char*& aTokenEnd, int& aRule) const;
+
+	static const int kMaxRules = 64;
+	static const int kMaxStates = 4096;
+
+private:
+	uint8_t mByteClass[256];
+	int mClassCount;
+	std::vector<uint16_t> mTransitions;	// [state * mClassCount + class], state 0 is dead
+	std::vector<uint64_t> mAccepts;		// rules accepting in each state, bit per pattern
+};
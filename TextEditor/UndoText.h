@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+
+// Storage for the text of the undo history. Texts are only ever added at the
+// end and dropped again from the front (oldest steps evicted) or from the back
+// (redo steps discarded by a new edit), so they are packed one after another
+// into large blocks instead of each step owning a heap string. A deletion of
+// any size costs one copy into a block and no per-step allocation. Every text
+// is followed by a '\0' so it can be handed on as a C string.
+class UndoText
+{
+public:
+	// Where a text lives; offsets grow forever and never refer to the same
+	// bytes twice
+	struct Span
+	{
+		uint64_t mOffset = 0;
+		size_t mLength = 0;
+
+		bool empty() const { return mLength == 0; }
+	};
+
+	static constexpr size_t kBlockSize = 64 * 1024;
+
+	Span Append(const char* aText, size_t aLength)
+	{
+		Span span;
+		if (aLength == 0)
+			return span;
+
+		if (mBlocks.empty() || mBlocks.back().mCapacity - mBlocks.back().mUsed < aLength + 1)
+		{
+			Block block;
+			block.mStart = mEnd;
+			block.mCapacity = std::max(kBlockSize, aLength + 1);
+			block.mData.reset(new char[block.mCapacity]);
+			mBlocks.push_back(std::move(block));
+		}
+
+		auto& block = mBlocks.back();
+		memcpy(block.mData.get() + block.mUsed, aText, aLength);
+		block.mData[block.mUsed + aLength] = '\0';
+		span.mOffset = mEnd;
+		span.mLength = aLength;
+		block.mUsed += aLength + 1;
+		mEnd += aLength + 1;
+		return span;
+	}
+
+	// Appends to aSpan in place, which only works for the last text added and
+	// while its block has room left
+	bool Extend(Span& aSpan, const char* aText, size_t aLength)
+	{
+		if (aSpan.empty() || mBlocks.empty() || aSpan.mOffset + aSpan.mLength + 1 != mEnd)
+			return false;
+
+		auto& block = mBlocks.back();
+		if (block.mCapacity - block.mUsed < aLength)
+			return false;
+
+		auto at = block.mData.get() + (aSpan.mOffset - block.mStart) + aSpan.mLength;
+		memcpy(at, aText, aLength);
+		at[aLength] = '\0';
+		aSpan.mLength += aLength;
+		block.mUsed += aLength;
+		mEnd += aLength;
+		return true;
+	}
+
+	const char* Get(const Span& aSpan) const
+	{
+		if (aSpan.empty())
+			return "";
+
+		auto it = std::upper_bound(mBlocks.begin(), mBlocks.end(), aSpan.mOffset,
+			[](uint64_t aOffset, const Block& aBlock) { return aOffset < aBlock.mStart; });
+		assert(it != mBlocks.begin());
+		--it;
+		return it->mData.get() + (aSpan.mOffset - it->mStart);
+	}
+
+	// Frees the blocks that hold nothing at or after aOffset
+	void DropBefore(uint64_t aOffset)
+	{
+		while (!mBlocks.empty() && mBlocks.front().mStart + mBlocks.front().mUsed <= aOffset)
+			mBlocks.pop_front();
+	}
+
+	// Forgets everything from aOffset on, so the next text goes there
+	void DropFrom(uint64_t aOffset)
+	{
+		while (!mBlocks.empty() && mBlocks.back().mStart >= aOffset)
+			mBlocks.pop_back();
+
+		if (!mBlocks.empty())
+		{
+			auto& block = mBlocks.back();
+			block.mUsed = std::min(block.mUsed, (size_t)(aOffset - block.mStart));
+		}
+		mEnd = std::min(mEnd, aOffset);
+	}
+
+	void Clear()
+	{
+		mBlocks.clear();
+	}
+
+private:
+	struct Block
+	{
+		uint64_t mStart = 0;
+		size_t mUsed = 0;
+		size_t mCapacity = 0;
+		std::unique_ptr<char[]> mData;
+	};
+
+	std::deque<Block> mBlocks;
+	uint64_t mEnd = 0;
+};
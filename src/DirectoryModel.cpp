@@ -0,0 +1,507 @@
+#include "DirectoryModel.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// A batch is handed to the UI after this many entries or this much time,
+// whichever comes first
+constexpr size_t ce_SCAN_BATCH_SIZE = 2048;
+constexpr auto ce_SCAN_BATCH_INTERVAL = std::chrono::milliseconds(50);
+
+static uint16_t ClampNameLength(size_t length)
+{
+    // NAME_MAX is far below this everywhere; a longer name is truncated
+    // rather than wrapped
+    return static_cast<uint16_t>(std::min<size_t>(length, UINT16_MAX));
+}
+
+uint64_t DirectoryEntryTable::MakeSortKey(std::string_view name)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        key <<= 8;
+        if (i < name.size())
+        {
+            key |= static_cast<unsigned char>(name[i]);
+        }
+    }
+    return key;
+}
+
+uint32_t DirectoryEntryTable::Add
+(
+    std::string_view name,
+    e_EntryType type,
+    uint64_t size,
+    int64_t modified_time,
+    e_FileClass file_class
+)
+{
+    uint32_t index = static_cast<uint32_t>(m_Types.size());
+    uint16_t length = ClampNameLength(name.size());
+
+    m_NameOffsets.push_back(static_cast<uint32_t>(m_Names.size()));
+    m_NameLengths.push_back(length);
+    m_Names.append(name.data(), length);
+    if (type == e_EntryType::FILE)
+    {
+        m_Names += " (";
+        m_Names += FormatSize(static_cast<double>(size));
+        m_Names += ')';
+    }
+    m_Names.push_back('\0');
+
+    m_Types.push_back(type);
+    m_FileClasses.push_back(file_class);
+    m_Sizes.push_back(size);
+    m_ModifiedTimes.push_back(modified_time);
+    m_SortKeys.push_back(MakeSortKey(name.substr(0, length)));
+    return index;
+}
+
+uint32_t DirectoryEntryTable::Append(const DirectoryEntryTable& other)
+{
+    uint32_t first = static_cast<uint32_t>(m_Types.size());
+    uint32_t name_base = static_cast<uint32_t>(m_Names.size());
+
+    m_Names += other.m_Names;
+    m_NameOffsets.reserve(m_NameOffsets.size() + other.m_NameOffsets.size());
+    for (uint32_t offset : other.m_NameOffsets)
+    {
+        m_NameOffsets.push_back(name_base + offset);
+    }
+    m_NameLengths.insert(m_NameLengths.end(), other.m_NameLengths.begin(), other.m_NameLengths.end());
+    m_Types.insert(m_Types.end(), other.m_Types.begin(), other.m_Types.end());
+    m_FileClasses.insert(m_FileClasses.end(), other.m_FileClasses.begin(), other.m_FileClasses.end());
+    m_Sizes.insert(m_Sizes.end(), other.m_Sizes.begin(), other.m_Sizes.end());
+    m_ModifiedTimes.insert(m_ModifiedTimes.end(), other.m_ModifiedTimes.begin(), other.m_ModifiedTimes.end());
+    m_SortKeys.insert(m_SortKeys.end(), other.m_SortKeys.begin(), other.m_SortKeys.end());
+    return first;
+}
+
+void DirectoryEntryTable::Clear()
+{
+    m_Names.clear();
+    m_NameOffsets.clear();
+    m_NameLengths.clear();
+    m_Types.clear();
+    m_FileClasses.clear();
+    m_Sizes.clear();
+    m_ModifiedTimes.clear();
+    m_SortKeys.clear();
+}
+
+void DirectoryEntryTable::Reserve(size_t count, size_t name_bytes)
+{
+    m_Names.reserve(name_bytes);
+    m_NameOffsets.reserve(count);
+    m_NameLengths.reserve(count);
+    m_Types.reserve(count);
+    m_FileClasses.reserve(count);
+    m_Sizes.reserve(count);
+    m_ModifiedTimes.reserve(count);
+    m_SortKeys.reserve(count);
+}
+
+void DirectoryModel::Listing::Clear()
+{
+    entries.Clear();
+    directories.clear();
+    files.clear();
+}
+
+// Appends a streamed batch, sorts its rows and merges them into the
+// already sorted ones
+void DirectoryModel::Listing::Merge(const DirectoryEntryTable& batch)
+{
+    if (batch.Size() == 0)
+    {
+        return;
+    }
+
+    uint32_t first = entries.Append(batch);
+    uint32_t last = static_cast<uint32_t>(entries.Size());
+    size_t old_directories = directories.size();
+    size_t old_files = files.size();
+
+    for (uint32_t i = first; i < last; ++i)
+    {
+        if (entries.GetType(i) == e_EntryType::DIRECTORY)
+        {
+            directories.push_back(i);
+        }
+        else
+        {
+            files.push_back(i);
+        }
+    }
+
+    auto less = [this](uint32_t a, uint32_t b) { return entries.Less(a, b); };
+    std::sort(directories.begin() + old_directories, directories.end(), less);
+    std::inplace_merge(directories.begin(), directories.begin() + old_directories, directories.end(), less);
+    std::sort(files.begin() + old_files, files.end(), less);
+    std::inplace_merge(files.begin(), files.begin() + old_files, files.end(), less);
+}
+
+void DirectoryModel::Listing::Erase(std::string_view name)
+{
+    auto by_name = [this](uint32_t index, std::string_view n) { return entries.GetName(index) < n; };
+
+    for (auto* rows : { &directories, &files })
+    {
+        auto it = std::lower_bound(rows->begin(), rows->end(), name, by_name);
+        if (it != rows->end() && entries.GetName(*it) == name)
+        {
+            rows->erase(it);
+        }
+    }
+
+    Compact();
+}
+
+void DirectoryModel::Listing::Insert(uint32_t index)
+{
+    auto& rows = (entries.GetType(index) == e_EntryType::DIRECTORY) ? directories : files;
+    auto it = std::lower_bound
+    (
+        rows.begin(), rows.end(), index,
+        [this](uint32_t a, uint32_t b) { return entries.Less(a, b); }
+    );
+    rows.insert(it, index);
+}
+
+// Erased entries stay in the table until they make up most of it, then the
+// live rows are copied into a fresh one
+void DirectoryModel::Listing::Compact()
+{
+    size_t live = directories.size() + files.size();
+    if (entries.Size() < 1024 || entries.Size() < live * 2)
+    {
+        return;
+    }
+
+    DirectoryEntryTable compacted;
+    compacted.Reserve(live, entries.GetNameBytes());
+    for (auto* rows : { &directories, &files })
+    {
+        for (uint32_t& index : *rows)
+        {
+            index = compacted.Add
+            (
+                entries.GetName(index),
+                entries.GetType(index),
+                entries.GetSize(index),
+                entries.GetModifiedTime(index),
+                entries.GetFileClass(index)
+            );
+        }
+    }
+    entries = std::move(compacted);
+}
+
+// Function to format file sizes
+std::string FormatSize(double size_in_bytes)
+{
+    constexpr std::array<std::string_view, 5> ce_UNITS =
+    {
+        "B", "KB", "MB", "GB", "TB"
+    };
+
+    std::size_t unit_idx = 0;
+    while (size_in_bytes >= 1024.0 && (unit_idx + 1) < ce_UNITS.size())
+    {
+        size_in_bytes /= 1024.0;
+        ++unit_idx;
+    }
+
+    return std::format("{:.2f} {}", size_in_bytes, ce_UNITS[unit_idx]);
+}
+
+DirectoryModel::~DirectoryModel()
+{
+    Cancel();
+}
+
+void DirectoryModel::SetClassifier(Classifier classifier)
+{
+    m_Classifier = std::move(classifier);
+}
+
+void DirectoryModel::Open(const fs::path& path)
+{
+    m_DeferredChanges.clear();
+    Cancel();
+    m_Path = path;
+    m_Current.Clear();
+    StartScan(false);
+}
+
+void DirectoryModel::Refresh()
+{
+    Cancel();
+    StartScan(true);
+}
+
+void DirectoryModel::Clear()
+{
+    m_DeferredChanges.clear();
+    Cancel();
+    m_Path.clear();
+    m_Current.Clear();
+    m_bPartial = false;
+}
+
+void DirectoryModel::Cancel()
+{
+    if (!m_Scan)
+    {
+        return;
+    }
+
+    // The thread notices on its next entry and exits by itself; we never
+    // wait on it, a slow network mount must not stall the UI
+    m_Scan->b_Cancelled = true;
+    m_Scan.reset();
+
+    if (m_bReplaceOnDone)
+    {
+        // Keep the complete old listing rather than half of a new one
+        m_Incoming.Clear();
+    }
+    else
+    {
+        m_bPartial = true;
+    }
+
+    auto deferred = std::move(m_DeferredChanges);
+    m_DeferredChanges.clear();
+    for (const auto& NAME : deferred)
+    {
+        ApplyChange(NAME);
+    }
+}
+
+void DirectoryModel::StartScan(bool b_Replace)
+{
+    m_bReplaceOnDone = b_Replace;
+    m_bPartial = false;
+    m_Incoming.Clear();
+
+    if (m_Path.empty())
+    {
+        return;
+    }
+
+    m_Scan = std::make_shared<ScanState>();
+    std::thread(ScanDirectory, m_Path, m_Classifier, m_Scan).detach();
+}
+
+void DirectoryModel::Update()
+{
+    if (!m_Scan)
+    {
+        return;
+    }
+
+    DirectoryEntryTable batch;
+    bool b_Done = false;
+    {
+        std::lock_guard<std::mutex> lock(m_Scan->mutex);
+        std::swap(batch, m_Scan->batch);
+        b_Done = m_Scan->b_Done;
+    }
+
+    if (m_bReplaceOnDone)
+    {
+        m_Incoming.Merge(batch);
+    }
+    else
+    {
+        m_Current.Merge(batch);
+    }
+
+    if (!b_Done)
+    {
+        return;
+    }
+
+    m_Scan.reset();
+    if (m_bReplaceOnDone)
+    {
+        std::swap(m_Current, m_Incoming);
+        m_Incoming.Clear();
+    }
+
+    auto deferred = std::move(m_DeferredChanges);
+    m_DeferredChanges.clear();
+    for (const auto& NAME : deferred)
+    {
+        ApplyChange(NAME);
+    }
+}
+
+size_t DirectoryModel::GetLoadedCount() const
+{
+    const Listing& listing = (m_Scan && m_bReplaceOnDone) ? m_Incoming : m_Current;
+    return listing.directories.size() + listing.files.size();
+}
+
+e_FileClass DirectoryModel::ClassifyName(const Classifier& classifier, std::string_view name)
+{
+    if (!classifier)
+    {
+        return e_FileClass::OTHER;
+    }
+
+    std::string extension = ToLowerExtension(name);
+    if (extension.empty())
+    {
+        return e_FileClass::OTHER;
+    }
+    return classifier(extension);
+}
+
+void DirectoryModel::ScanDirectory
+(
+    fs::path path,
+    Classifier classifier,
+    std::shared_ptr<ScanState> state
+)
+{
+    DirectoryEntryTable batch;
+    auto last_flush = std::chrono::steady_clock::now();
+
+    auto flush = [&](bool b_Done)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->batch.Size() == 0)
+        {
+            std::swap(state->batch, batch);
+        }
+        else
+        {
+            state->batch.Append(batch);
+        }
+        batch.Clear();
+        state->b_Done = b_Done;
+        last_flush = std::chrono::steady_clock::now();
+    };
+
+    std::error_code ec;
+    if (!fs::is_directory(path, ec))
+    {
+        flush(true);
+        return;
+    }
+
+    fs::directory_iterator it
+    (
+        path,
+        fs::directory_options::skip_permission_denied,
+        ec
+    );
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec))
+    {
+        if (state->b_Cancelled)
+        {
+            return;
+        }
+
+        const fs::directory_entry& ENTRY = *it;
+        std::error_code entry_ec;
+        std::string name = ENTRY.path().filename().string();
+
+        int64_t modified_time = ENTRY.last_write_time(entry_ec).time_since_epoch().count();
+        if (entry_ec)
+        {
+            modified_time = 0;
+        }
+
+        if (ENTRY.is_regular_file(entry_ec))
+        {
+            uint64_t size = ENTRY.file_size(entry_ec);
+            if (entry_ec)
+            {
+                size = 0;
+            }
+            batch.Add(name, e_EntryType::FILE, size, modified_time, ClassifyName(classifier, name));
+        }
+        else if (ENTRY.is_directory(entry_ec))
+        {
+            batch.Add(name, e_EntryType::DIRECTORY, 0, modified_time, e_FileClass::OTHER);
+        }
+
+        if (batch.Size() >= ce_SCAN_BATCH_SIZE
+            || std::chrono::steady_clock::now() - last_flush >= ce_SCAN_BATCH_INTERVAL)
+        {
+            flush(false);
+        }
+    }
+
+    flush(true);
+}
+
+void DirectoryModel::ApplyChange(const std::string& name)
+{
+    if (m_Path.empty())
+    {
+        return;
+    }
+
+    if (m_Scan)
+    {
+        // The scan may still deliver this entry; patch it afterwards
+        m_DeferredChanges.push_back(name);
+        return;
+    }
+
+    m_Current.Erase(name);
+
+    std::error_code ec;
+    fs::directory_entry entry(m_Path / name, ec);
+    if (ec)
+    {
+        return; // Removed (or not readable any more)
+    }
+
+    int64_t modified_time = entry.last_write_time(ec).time_since_epoch().count();
+    if (ec)
+    {
+        modified_time = 0;
+    }
+
+    uint32_t index = 0;
+    if (entry.is_regular_file(ec))
+    {
+        uint64_t size = entry.file_size(ec);
+        if (ec)
+        {
+            size = 0;
+        }
+        index = m_Current.entries.Add
+        (
+            name,
+            e_EntryType::FILE,
+            size,
+            modified_time,
+            ClassifyName(m_Classifier, name)
+        );
+    }
+    else if (entry.is_directory(ec))
+    {
+        index = m_Current.entries.Add(name, e_EntryType::DIRECTORY, 0, modified_time, e_FileClass::OTHER);
+    }
+    else
+    {
+        return;
+    }
+
+    m_Current.Insert(index);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FileTypes.h"
+
+namespace fs = std::filesystem;
+
+// Function to format file sizes
+std::string FormatSize(double size_in_bytes);
+
+enum class e_EntryType : uint8_t { FILE, DIRECTORY };
+
+// Struct-of-arrays store for directory entries. Names are packed into one
+// NUL-terminated arena, a file's followed by its formatted size so the row
+// text is ready to draw, and every other field lives in its own flat array,
+// so an entry costs a few dozen bytes and no allocation of its own, and
+// sorting or filtering walks contiguous memory. Entries are addressed by
+// index and never move; removal is left to the owner's row order.
+class DirectoryEntryTable
+{
+public:
+    // Function to append an entry and return its index
+    uint32_t Add
+    (
+        std::string_view name,
+        e_EntryType type,
+        uint64_t size,
+        int64_t modified_time,
+        e_FileClass file_class
+    );
+
+    // Function to append every entry of another table, returns the index of
+    // the first one
+    uint32_t Append(const DirectoryEntryTable& other);
+
+    void Clear();
+    void Reserve(size_t count, size_t name_bytes);
+
+    size_t Size() const { return m_Types.size(); }
+    size_t GetNameBytes() const { return m_Names.size(); }
+
+    std::string_view GetName(uint32_t index) const
+    {
+        return { m_Names.data() + m_NameOffsets[index], m_NameLengths[index] };
+    }
+    // Function to get the row text: the name, and for a file its size as
+    // formatted when the entry was added, "notes.txt (1.50 KB)"
+    const char* GetLabel(uint32_t index) const { return m_Names.c_str() + m_NameOffsets[index]; }
+    e_EntryType GetType(uint32_t index) const { return m_Types[index]; }
+    e_FileClass GetFileClass(uint32_t index) const { return m_FileClasses[index]; }
+    uint64_t GetSize(uint32_t index) const { return m_Sizes[index]; }
+    int64_t GetModifiedTime(uint32_t index) const { return m_ModifiedTimes[index]; }
+
+    // Function to order two entries by name, byte-wise
+    bool Less(uint32_t a, uint32_t b) const
+    {
+        if (m_SortKeys[a] != m_SortKeys[b])
+        {
+            return m_SortKeys[a] < m_SortKeys[b];
+        }
+        return GetName(a) < GetName(b);
+    }
+
+    // Function to compute the sort key of a name: its first eight bytes,
+    // big-endian, so most comparisons are one integer compare
+    static uint64_t MakeSortKey(std::string_view name);
+
+private:
+    std::string m_Names;
+    std::vector<uint32_t> m_NameOffsets;
+    std::vector<uint16_t> m_NameLengths;
+    std::vector<e_EntryType> m_Types;
+    std::vector<e_FileClass> m_FileClasses;
+    std::vector<uint64_t> m_Sizes;
+    std::vector<int64_t> m_ModifiedTimes;
+    std::vector<uint64_t> m_SortKeys;
+};
+
+// Cached listing of a single directory. The listing is enumerated once on a
+// worker thread when a directory is opened and streamed in batch by batch,
+// then only re-read on an explicit Refresh() or patched per entry from
+// change notifications, so rendering the explorer panel never touches the
+// filesystem.
+class DirectoryModel
+{
+public:
+    // Maps a lower-case extension (".png") to its file class. Called from
+    // the scan thread, so it must not touch shared mutable state.
+    using Classifier = std::function<e_FileClass(std::string_view extension)>;
+
+    DirectoryModel() = default;
+    ~DirectoryModel();
+
+    DirectoryModel(const DirectoryModel&) = delete;
+    DirectoryModel& operator=(const DirectoryModel&) = delete;
+
+    // Function to set how file classes are assigned, applies to later scans
+    void SetClassifier(Classifier classifier);
+
+    // Function to start loading the listing of a new directory
+    void Open(const fs::path& path);
+
+    // Function to re-read the current directory from disk. The old listing
+    // stays visible until the new one is complete.
+    void Refresh();
+
+    // Function to drop the listing (no directory opened)
+    void Clear();
+
+    // Function to stop an in-flight scan and keep what was read so far
+    void Cancel();
+
+    // Function to pull streamed batches from the scan thread, call once per frame
+    void Update();
+
+    // Function to re-stat a single entry and update the listing in place
+    void ApplyChange(const std::string& name);
+
+    const fs::path& GetPath() const { return m_Path; }
+
+    // Rows in display order, each an index into GetEntries()
+    const DirectoryEntryTable& GetEntries() const { return m_Current.entries; }
+    const std::vector<uint32_t>& GetDirectories() const { return m_Current.directories; }
+    const std::vector<uint32_t>& GetFiles() const { return m_Current.files; }
+    bool IsEmpty() const { return m_Current.directories.empty() && m_Current.files.empty(); }
+
+    bool IsLoading() const { return m_Scan != nullptr; }
+    bool IsPartial() const { return m_bPartial; }
+    size_t GetLoadedCount() const;
+
+private:
+    // An entry table plus the sorted rows that are still live in it
+    struct Listing
+    {
+        DirectoryEntryTable entries;
+        std::vector<uint32_t> directories;
+        std::vector<uint32_t> files;
+
+        void Clear();
+        void Merge(const DirectoryEntryTable& batch);
+        void Erase(std::string_view name);
+        void Insert(uint32_t index);
+        void Compact();
+    };
+
+    // Shared between the UI and one scan thread. The thread only ever
+    // touches its own ScanState, so an abandoned scan can finish on its own.
+    struct ScanState
+    {
+        std::mutex mutex;
+        DirectoryEntryTable batch;
+        bool b_Done = false;
+        std::atomic<bool> b_Cancelled = false;
+    };
+
+    void StartScan(bool b_Replace);
+    static void ScanDirectory(fs::path path, Classifier classifier, std::shared_ptr<ScanState> state);
+    static e_FileClass ClassifyName(const Classifier& classifier, std::string_view name);
+
+    fs::path m_Path;
+    Classifier m_Classifier;
+    Listing m_Current;
+
+    std::shared_ptr<ScanState> m_Scan;
+    bool m_bReplaceOnDone = false;
+    bool m_bPartial = false;
+    Listing m_Incoming;
+
+    // Change notifications that arrive mid-scan are applied once it ends
+    std::vector<std::string> m_DeferredChanges;
+};
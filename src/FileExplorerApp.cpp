@@ -1,5 +1,9 @@
 #include "FileExplorerApp.h"
 #include "ImGuiCustomTheme.h"
+#include <rlgl.h>
+
+// Pixel data uploaded to the GPU per frame while an image streams in
+constexpr int ce_IMG_UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
 
 FileExplorerApp::FileExplorerApp()
 {
@@ -32,19 +36,28 @@ FileExplorerApp::FileExplorerApp()
     m_SelectedFile = fs::path();    // To store the selected file path
     m_bFileLoaded = false;          // Track if file is loaded
     m_bFileModified = false;        // Track if file has been modified
+    m_EditRevision = 0;
     m_bExit = false;
     m_bShowExitConfirm = false;
 	m_bShowSaveBeforeOpenConfirm = false;
     m_bShowSaveBeforeDirChangeConfirm = false;
+    m_bSelectedFileChangedOnDisk = false;
+    m_SelectedFileWriteTime = fs::file_time_type();
 
     // Image handling variables
     m_ImgTexture = { 0 };           	// Initialize to empty texture
+    m_PendingImgTexture = { 0 };        // Texture still being uploaded
+    m_ImgUploadedRows = 0;
     m_bImgLoaded = false;           	// Track if image is loaded
     m_LoadedImgPath = fs::path();   	// Track which image is currently loaded
 	m_PendingFileToOpen = fs::path();  
     m_PendingDirectoryToNavigate = fs::path();
 
     // UI state variables
+    m_bShowFindBar = false;
+    m_bFocusFindInput = false;
+    m_bFindMatchCase = false;
+    m_bFindRegex = false;
     m_bShowSaveDialog = false;
     m_bShowErrorPopup = false;
     m_ErrorMessage.clear();
@@ -58,29 +71,38 @@ FileExplorerApp::FileExplorerApp()
     m_TextEditor.SetHandleMouseInputs(true);
     m_TextEditor.SetImGuiChildIgnored(false);
 
-    m_SupportedFileTypes =
-    {
-        ".txt", ".cpp", ".h",
-        ".hpp", ".c", ".py",
-        ".js", ".html",".css",
-        ".json", ".md", ".xml",
-        ".yaml", ".ini", ".log",
-        ".bat", ".sh", ".php",
-        ".rb", ".go", ".swift",
-        ".ts", ".tsx", ".vue",
-        ".sql", ".pl", ".lua",
-        ".r", ".dart", ".scala",
-        ".rs", ".java", ".kt"
-    };
-
-    m_SupportedImgTypes = 
-    {
-        ".jpg", ".png", ".bmp" 
-    };
+    // Built-in file types, plus whatever the user added in the config file
+    string config_error;
+    if (!m_FileTypes.LoadConfig("assets/file_types.cfg", config_error))
+    {
+        m_ErrorMessage = "Invalid file type config: " + config_error;
+        m_bShowErrorPopup = true;
+    }
+
+    // Classified once per entry while listing; the lambda owns a copy of
+    // the registry because it runs on the scan thread
+    m_DirectoryModel.SetClassifier
+    (
+        [file_types = m_FileTypes](string_view ext)
+        {
+            return file_types.Lookup(ext).file_class;
+        }
+    );
 }
 
 FileExplorerApp::~FileExplorerApp()
 {
+    // Don't wait for a half-read file on the way out
+    CancelFileLoad();
+    CancelImageLoad();
+
+    // But never drop a save, the I/O thread runs them in order so the last
+    // one is done when everything is
+    while (!m_FileSaves.empty() && !m_FileSaves.back().job->IsDone())
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
     // Clean up loaded texture before closing
     if (m_bImgLoaded && m_ImgTexture.id != 0)
     {
@@ -148,6 +170,12 @@ void FileExplorerApp::Run()
 
         ProcessFileBrowserDialog(sb_Open);
 
+        // Pick up the saves that finished on the I/O thread, in order
+        while (!m_FileSaves.empty() && m_FileSaves.front().job->IsDone())
+        {
+            FinishFileSave();
+        }
+
         ProcessSaveFile(sb_Save);
 
         HandleErrorPopup();
@@ -166,6 +194,8 @@ void FileExplorerApp::Run()
 
         HandleSaveBeforeDirChangePopup();
 
+        ProcessFileChanges();
+
         RenderExplorerPanel(menu_bar_height, sb_Open);
 
         UpdateSideMenuWidth();
@@ -211,6 +241,10 @@ void FileExplorerApp::RenderMainMenuBar
             {
                 b_Save = true;
             }
+            if (ImGui::MenuItem("Refresh", "F5", false, !current_path.empty()))
+            {
+                RefreshDirectory();
+            }
             ImGui::Separator();
             if (ImGui::MenuItem("Exit", "Escape"))
             {
@@ -243,6 +277,21 @@ void FileExplorerApp::RenderMainMenuBar
             {
                 b_Delete = true;
             }
+            ImGui::Separator();
+            if
+            (
+                ImGui::MenuItem
+                (
+                    "Find / Replace",
+                    "Ctrl+F",
+                    false,
+                    m_bFileLoaded && !m_LargeFileViewer.IsOpen()
+                )
+            )
+            {
+                m_bShowFindBar = true;
+                m_bFocusFindInput = true;
+            }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Help"))
@@ -296,10 +345,22 @@ void FileExplorerApp::ApplyShortcuts
     {
         b_CreateNewFolder = true;
     }
+    if (ImGui::IsKeyPressed(ImGuiKey_F)
+        && ImGui::GetIO().KeyCtrl
+        && m_bFileLoaded
+        && !m_LargeFileViewer.IsOpen())
+    {
+        m_bShowFindBar = true;
+        m_bFocusFindInput = true;
+    }
     if (ImGui::IsKeyPressed(ImGuiKey_F2))
     {
         b_RenameFile = true;
     }
+    if (ImGui::IsKeyPressed(ImGuiKey_F5) && !current_path.empty())
+    {
+        RefreshDirectory();
+    }
 }
 
 // Function to process the file browser dialog
@@ -344,28 +405,118 @@ void FileExplorerApp::ProcessSaveFile(bool& b_Save)
     // Save File
     if (b_Save
         && m_SelectedFile != fs::path()
-        && m_bFileLoaded)
+        && m_bFileLoaded
+        && !m_LargeFileViewer.IsOpen())
     {
-        // Get text from the editor
-        string content = m_TextEditor.GetText();
-        
-        ofstream out_file(m_SelectedFile, ios::out | ios::binary);
-        if (out_file.is_open())
-        {
-            out_file.write(content.data(), content.size());
-            out_file.close();
-            m_bFileModified = false;
-            b_Save = false;
-        }
-        else
+        StartFileSave(e_AfterSave::NOTHING);
+        b_Save = false;
+    }
+}
+
+// Function to render the find and replace bar above the text editor. The
+// editor keeps the match count current as the text changes; Enter in the
+// find field jumps to the next match, Shift+Enter to the previous one.
+void FileExplorerApp::RenderFindBar()
+{
+    bool b_SearchChanged = false;
+
+    if (m_bFocusFindInput)
+    {
+        ImGui::SetKeyboardFocusHere();
+        m_bFocusFindInput = false;
+        b_SearchChanged = true;
+    }
+
+    string previous_query = m_FindQuery;
+    ImGui::SetNextItemWidth(250.0f);
+    if
+    (
+        ImGui::InputTextWithHint
+        (
+            "##Find",
+            "Find",
+            &m_FindQuery,
+            ImGuiInputTextFlags_EnterReturnsTrue
+        )
+    )
+    {
+        m_TextEditor.FindNext(ImGui::GetIO().KeyShift);
+        ImGui::SetKeyboardFocusHere(-1);
+    }
+    b_SearchChanged |= m_FindQuery != previous_query;
+
+    ImGui::SameLine();
+    b_SearchChanged |= ImGui::Checkbox("Match case", &m_bFindMatchCase);
+    ImGui::SameLine();
+    b_SearchChanged |= ImGui::Checkbox("Regex", &m_bFindRegex);
+
+    if (b_SearchChanged)
+    {
+        m_TextEditor.SetSearch(m_FindQuery, m_bFindRegex, m_bFindMatchCase);
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Previous"))
+    {
+        m_TextEditor.FindNext(true);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Next"))
+    {
+        m_TextEditor.FindNext();
+    }
+
+    ImGui::SameLine();
+    if (!m_TextEditor.GetSearchError().empty())
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", m_TextEditor.GetSearchError().c_str());
+    }
+    else if (!m_FindQuery.empty())
+    {
+        ImGui::Text
+        (
+            "%d matches%s",
+            m_TextEditor.GetSearchMatchCount(),
+            m_TextEditor.IsSearchPending() ? "..." : ""
+        );
+
+        // Too long for std::regex to search without running out of stack
+        if (m_TextEditor.GetSearchSkippedLines() > 0)
         {
-            m_ErrorMessage = 
-            "Could not save file: " + m_SelectedFile.string();
-            
-            m_bShowErrorPopup = true;
-            b_Save = false;
+            ImGui::SameLine();
+            ImGui::TextDisabled
+            (
+                "(%d lines over %zu bytes skipped)",
+                m_TextEditor.GetSearchSkippedLines(),
+                TextSearch::kMaxRegexLineLength
+            );
         }
     }
+
+    ImGui::SetNextItemWidth(250.0f);
+    ImGui::InputTextWithHint("##Replace", "Replace", &m_ReplaceText);
+    ImGui::SameLine();
+    // The editor only reports edits made inside its own Render, so these
+    // mark the file modified themselves
+    if (ImGui::Button("Replace") && m_TextEditor.Replace(m_ReplaceText))
+    {
+        m_bFileModified = true;
+        ++m_EditRevision;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Replace All") && m_TextEditor.ReplaceAll(m_ReplaceText) > 0)
+    {
+        m_bFileModified = true;
+        ++m_EditRevision;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Close"))
+    {
+        m_bShowFindBar = false;
+        m_TextEditor.ClearSearch();
+    }
+
+    ImGui::Separator();
 }
 
 // Function to handle error popups
@@ -490,6 +641,7 @@ void FileExplorerApp::HandleCreateFilePopup(bool& b_CreateNewFile)
                 if (FILE.is_open())
                 {
                     FILE.close();
+                    RefreshDirectory();
                     m_SelectedFile = new_file_path;
                     m_bFileLoaded = false;
                     m_bFileModified = false;
@@ -593,12 +745,14 @@ void FileExplorerApp::HandleRenamePopup(bool& b_RenameFile)
                 {
                     try
                     {
+                        ReleaseLargeFile();
                         fs::rename(source_path, new_path);
 
                         // Update paths after successful rename
                         if (b_RenamingSelectedFile)
                         {
                             m_SelectedFile = new_path;
+                            RefreshDirectory();
                         }
                         else
                         {
@@ -698,10 +852,12 @@ void FileExplorerApp::HandleDeletePopup(bool& b_Delete)
         {
             try
             {
+                ReleaseLargeFile();
                 if (b_RenamingSelectedFile)
                 {
                     fs::remove_all(m_SelectedFile);
                     m_SelectedFile = fs::path();
+                    RefreshDirectory();
                 }
                 else
                 {
@@ -766,19 +922,15 @@ void FileExplorerApp::HandleExitConfirmPopup()
         float spacing = ImGui::GetStyle().ItemSpacing.x;
         if (ImGui::Button("Save", ImVec2(button_width + 20, 0)))
         {
-            // Save the file first
+            // Save the file first, and stay open if that fails
             if (m_SelectedFile != fs::path() && m_bFileLoaded)
             {
-                string content = m_TextEditor.GetText();
-                ofstream out_file(m_SelectedFile, ios::out | ios::binary);
-                if (out_file.is_open())
-                {
-                    out_file.write(content.data(), content.size());
-                    out_file.close();
-                    m_bFileModified = false;
-                }
+                StartFileSave(e_AfterSave::EXIT);
+            }
+            else
+            {
+                m_bExit = true;
             }
-            m_bExit = true;
             ImGui::CloseCurrentPopup();
         }
         
@@ -831,19 +983,15 @@ void FileExplorerApp::HandleSaveBeforeOpenPopup()
         float spacing = ImGui::GetStyle().ItemSpacing.x;
 		if (ImGui::Button("Save", ImVec2(button_width + 20, 0)))
 		{
+			// The new file opens once the save went through
 			if (m_SelectedFile != fs::path() && m_bFileLoaded)
             {
-                string content = m_TextEditor.GetText();
-                ofstream out_file(m_SelectedFile, ios::out | ios::binary);
-                if (out_file.is_open())
-                {
-                    out_file.write(content.data(), content.size());
-                    out_file.close();
-                    m_bFileModified = false;
-                }
+                StartFileSave(e_AfterSave::OPEN_FILE);
+            }
+            else
+            {
+                FileExplorerApp::OpenFile(m_PendingFileToOpen);
             }
-
-			FileExplorerApp::OpenFile(m_PendingFileToOpen);
             ImGui::CloseCurrentPopup();
 		}
 
@@ -946,34 +1094,61 @@ void FileExplorerApp::RenderExplorerPanel(float menu_bar_height, bool& b_Open)
         ImGui::Separator();
     }
 
-    // Get and display files with better organization
-    auto directory_contents = GetFilesInDirectory(current_path);
-
-    enum class e_FileType { DIR, FILE };
-    struct FileEntry
+    // The listing is cached and only re-read on navigation or refresh
+    if (m_DirectoryModel.GetPath() != current_path)
     {
-        std::string name;
-        e_FileType type;
-        string size_or_marker;
-    };
+        m_DirectoryModel.Open(current_path);
+        UpdateWatches();
+    }
 
-    // Separate directories and files
-    vector<FileEntry> dir_entries;
-    vector<FileEntry> file_entries;
+    // Pull whatever the background scan produced since the last frame
+    m_DirectoryModel.Update();
 
-    for (const auto& [name, info] : directory_contents)
+    if (m_DirectoryModel.IsLoading())
     {
-        if(info == "[D]")
+        ImGui::TextColored
+        (
+            ImVec4(0.7f, 0.7f, 0.7f, 1.0f),
+            "Loading... %zu entries",
+            m_DirectoryModel.GetLoadedCount()
+        );
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Stop"))
         {
-            dir_entries.emplace_back(name, e_FileType::DIR, "[D]");
+            m_DirectoryModel.Cancel();
         }
-        else
+    }
+    else if (m_DirectoryModel.IsPartial())
+    {
+        ImGui::TextColored
+        (
+            ImVec4(1.0f, 0.6f, 0.0f, 1.0f),
+            "Partial listing (%zu entries)",
+            m_DirectoryModel.GetLoadedCount()
+        );
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Reload"))
         {
-            file_entries.emplace_back(name, e_FileType::FILE, info);
+            RefreshDirectory();
         }
     }
 
-    // Display directories first
+    const DirectoryEntryTable& entries = m_DirectoryModel.GetEntries();
+    const auto& dir_entries = m_DirectoryModel.GetDirectories();
+    const auto& file_entries = m_DirectoryModel.GetFiles();
+
+    // Selection is matched by name, so rows never have to build a path
+    string selected_name;
+    if (!m_SelectedFile.empty() && m_SelectedFile.parent_path() == current_path)
+    {
+        selected_name = m_SelectedFile.filename().string();
+    }
+
+    // Navigation clears the listing, so it is applied after the loops
+    fs::path navigate_to;
+
+    // Display directories first. Only rows inside the visible region are
+    // submitted, the clipper skips the rest with a single cursor advance.
     if (!dir_entries.empty())
     {
         ImGui::TextColored
@@ -984,44 +1159,42 @@ void FileExplorerApp::RenderExplorerPanel(float menu_bar_height, bool& b_Open)
             ), 
             "Directories:"
         );
-        for (const auto& ENTRY : dir_entries)
+
+        ImGuiListClipper dir_clipper;
+        dir_clipper.Begin(static_cast<int>(dir_entries.size()));
+        while (dir_clipper.Step())
         {
-            string label = ENTRY.name;
-            fs::path dir_path = current_path / ENTRY.name;
-            bool b_IsSelected = (m_SelectedFile == dir_path);
+            for (int i = dir_clipper.DisplayStart; i < dir_clipper.DisplayEnd; ++i)
+            {
+                uint32_t entry = dir_entries[i];
+                string_view name = entries.GetName(entry);
+                bool b_IsSelected = (name == selected_name);
 
-            // Start a group to keep icon and text together
-            ImGui::BeginGroup();
+                // Start a group to keep icon and text together
+                ImGui::BeginGroup();
 
-            // Draw the icon first
-            rlImGuiImage(&m_FolderIcon);
-            ImGui::SameLine();
+                // Draw the icon first
+                rlImGuiImage(&m_FolderIcon);
+                ImGui::SameLine();
 
-            ImVec2 cursor_pos = ImGui::GetCursorPos();
-            ImGui::SetCursorPos
-            (
-                ImVec2
+                ImVec2 cursor_pos = ImGui::GetCursorPos();
+                ImGui::SetCursorPos
                 (
-                    cursor_pos.x - 6.0f, 
-                    cursor_pos.y + 6.0f
-                )
-            );
+                    ImVec2
+                    (
+                        cursor_pos.x - 6.0f, 
+                        cursor_pos.y + 6.0f
+                    )
+                );
 
-            // Then draw the selectable
-			if (ImGui::Selectable(label.c_str(), b_IsSelected))
-			{
-			    if (m_bFileModified)
-			    {
-			        m_PendingDirectoryToNavigate = dir_path;
-                    m_bShowSaveBeforeDirChangeConfirm = true;
-			    }
-			    else
-			    {
-			        NavigateToDirectory(dir_path);
-			    }
-			}
-
-            ImGui::EndGroup();
+                // Then draw the selectable
+                if (ImGui::Selectable(entries.GetLabel(entry), b_IsSelected))
+                {
+                    navigate_to = current_path / name;
+                }
+
+                ImGui::EndGroup();
+            }
         }
     }
 
@@ -1029,67 +1202,86 @@ void FileExplorerApp::RenderExplorerPanel(float menu_bar_height, bool& b_Open)
     if (!file_entries.empty())
     {
         ImGui::TextColored(ImVec4(0.7f, 1.0f, 0.7f, 1.0f), "Files:");
-        for (const auto& ENTRY : file_entries)
-        {
-            fs::path file_path = current_path / ENTRY.name;
-            bool b_IsSelected = (m_SelectedFile == file_path);
-            Texture2D icon = m_FileIcon;
-            string ext = fs::path(ENTRY.name).extension().string();
 
-            if (ranges::contains(m_SupportedImgTypes, ext))
-            {
-                icon = m_ImgIcon;
-            }
-            else if (ranges::contains(m_SupportedFileTypes, ext))
+        ImGuiListClipper file_clipper;
+        file_clipper.Begin(static_cast<int>(file_entries.size()));
+        while (file_clipper.Step())
+        {
+            for (int i = file_clipper.DisplayStart; i < file_clipper.DisplayEnd; ++i)
             {
-                icon = m_EditFileIcon;
-            }
+                uint32_t entry = file_entries[i];
+                string_view name = entries.GetName(entry);
+                bool b_IsSelected = (name == selected_name);
+                Texture2D icon = m_FileIcon;
 
-            string label = ENTRY.name + " (" + ENTRY.size_or_marker + ")";
+                e_FileClass file_class = entries.GetFileClass(entry);
+                if (file_class == e_FileClass::IMAGE)
+                {
+                    icon = m_ImgIcon;
+                }
+                else if (file_class == e_FileClass::TEXT)
+                {
+                    icon = m_EditFileIcon;
+                }
 
-            // Start a group to keep icon and text together
-            ImGui::BeginGroup();
+                // Start a group to keep icon and text together
+                ImGui::BeginGroup();
 
-            // Draw the icon first
-            rlImGuiImage(&icon);
-            ImGui::SameLine();
+                // Draw the icon first
+                rlImGuiImage(&icon);
+                ImGui::SameLine();
 
-            ImVec2 cursor_pos = ImGui::GetCursorPos();
-            ImGui::SetCursorPos
-            (
-                ImVec2
+                ImVec2 cursor_pos = ImGui::GetCursorPos();
+                ImGui::SetCursorPos
                 (
-                    cursor_pos.x - 6.0f, 
-                    cursor_pos.y + 6.0f
-                )
-            );
+                    ImVec2
+                    (
+                        cursor_pos.x - 6.0f, 
+                        cursor_pos.y + 6.0f
+                    )
+                );
+
+                // Then draw the selectable
+                if (ImGui::Selectable(entries.GetLabel(entry), b_IsSelected))
+                {
+                    fs::path file_path = current_path / name;
+                    if (m_bFileModified)
+                    {
+                        // Store the file the user wants to open and show confirmation
+                        m_PendingFileToOpen = file_path;
+                        m_bShowSaveBeforeOpenConfirm = true;
+                    }
+                    else
+                    {
+                        // Only process if it's a different file
+                        if (m_SelectedFile != file_path)
+                        {
+                            OpenFile(file_path);
+                        }
+                    }
+                }
 
-            // Then draw the selectable
-			if (ImGui::Selectable(label.c_str(), b_IsSelected))
-			{
-			    if (m_bFileModified)
-			    {
-			        // Store the file the user wants to open and show confirmation
-			        m_PendingFileToOpen = file_path;
-			        m_bShowSaveBeforeOpenConfirm = true;
-			    }
-			    else
-			    {
-			        // Only process if it's a different file
-			        if (m_SelectedFile != file_path)
-			        {
-			            OpenFile(file_path);
-			        }
-			    }
-			}
-
-            ImGui::EndGroup();
+                ImGui::EndGroup();
+            }
+        }
+    }
+
+    if (!navigate_to.empty())
+    {
+        if (m_bFileModified)
+        {
+            m_PendingDirectoryToNavigate = navigate_to;
+            m_bShowSaveBeforeDirChangeConfirm = true;
+        }
+        else
+        {
+            NavigateToDirectory(navigate_to);
         }
     }
 
     ImGui::Separator();
 
-    if (directory_contents.empty())
+    if (m_DirectoryModel.IsEmpty() && !m_DirectoryModel.IsLoading())
     {
         ImGui::TextColored
         (
@@ -1135,22 +1327,7 @@ void FileExplorerApp::HandleSaveBeforeDirChangePopup()
         {
             if (m_SelectedFile != fs::path() && m_bFileLoaded)
             {
-                string content = m_TextEditor.GetText();
-                ofstream out_file(m_SelectedFile, ios::out | ios::binary);
-                if (out_file.is_open())
-                {
-                    out_file.write(content.data(), content.size());
-                    out_file.close();
-                    m_bFileModified = false;
-                    NavigateToDirectory(m_PendingDirectoryToNavigate);
-                    m_PendingDirectoryToNavigate = fs::path();
-                }
-                else
-                {
-                    m_ErrorMessage = "Could not save file: " + m_SelectedFile.string();
-                    m_bShowErrorPopup = true;
-                    m_PendingDirectoryToNavigate = fs::path();
-                }
+                StartFileSave(e_AfterSave::CHANGE_DIRECTORY);
             }
             ImGui::CloseCurrentPopup();
         }
@@ -1212,6 +1389,10 @@ void FileExplorerApp::RenderFileViewer(float menu_bar_height)
         {
             window_title += " *";
         }
+        if (IsSavingFile(m_SelectedFile))
+        {
+            window_title += " (saving...)";
+        }
 
         ImGui::SetNextWindowPos
         (
@@ -1272,61 +1453,70 @@ void FileExplorerApp::RenderFileViewer(float menu_bar_height)
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "(Modified)");
         }
+
+        // Show if someone else changed the file since we loaded it
+        if (m_bSelectedFileChangedOnDisk)
+        {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "(Changed on disk)");
+            if (!m_bFileModified && m_bFileLoaded)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Reload"))
+                {
+                    m_bFileLoaded = false;
+                    m_bSelectedFileChangedOnDisk = false;
+                }
+            }
+        }
         
         ImGui::Separator();
-        string file_ext = m_SelectedFile.extension().string();
-
-        // Upper to Lower case conversion ( Ascii for maximum speed )
-        ranges::for_each(file_ext, [](char &c) { if (c >= 'A' && c <= 'Z') c += 32; });
+        string file_ext = ToLowerExtension(m_SelectedFile.filename().string());
+        FileTypeInfo file_type = m_FileTypes.Lookup(file_ext);
 
         // Handle text files with syntax highlighting
-        if (ranges::contains(m_SupportedFileTypes, file_ext))
+        if (file_type.file_class == e_FileClass::TEXT)
         {
             if (!m_bFileLoaded)
             {
-                ifstream FILE(m_SelectedFile, ios::in | ios::binary);
-                if (FILE.is_open())
+                // A load for a file that is no longer selected is dropped
+                if (m_FileLoadJob && m_LoadingFile != m_SelectedFile)
                 {
-                    FILE.seekg(0, ios::end);
-                    size_t fileSize = FILE.tellg();
-                    FILE.seekg(0, ios::beg);
-
-                    if (fileSize > ce_MAX_BUFFER_SIZE)
-                    {
-                        m_ErrorMessage = "File too large! Maximum size: " 
-                        + to_string(ce_MAX_BUFFER_SIZE / (1024 * 1024)) 
-                        + " MB";
+                    CancelFileLoad();
+                }
 
-                        m_bShowErrorPopup = true;
-                        FILE.close();
-                        return;
-                    }
-                    else
-                    {
-                        // Read file content
-                        vector<char> buffer(fileSize + 1);
-                        FILE.read(buffer.data(), fileSize);
-                        buffer[fileSize] = '\0';
-                        
-                        // Set text in the editor
-                        m_TextEditor.SetText(string(buffer.data()));
-                        SetEditorLanguage(m_SelectedFile);
-                        
-                        m_bFileLoaded = true;
-                        m_bFileModified = false;
-                    }
-                    FILE.close();
+                if (!m_FileLoadJob)
+                {
+                    StartFileLoad();
                 }
-                else
+                else if (m_FileLoadJob->IsDone())
                 {
-                    m_ErrorMessage = "Could not open file: "
-                                   + m_SelectedFile.string();
-                    m_bShowErrorPopup = true;
+                    FinishFileLoad();
                 }
             }
 
-            if (m_bFileLoaded)
+            if (!m_bFileLoaded && m_FileLoadJob)
+            {
+                ImGui::ProgressBar
+                (
+                    m_FileLoadJob->GetProgress(),
+                    ImVec2(-1.0f, 0.0f),
+                    "Loading..."
+                );
+            }
+
+            if (m_bFileLoaded && m_LargeFileViewer.IsOpen())
             {
+                m_LargeFileViewer.Update();
+                m_LargeFileViewer.Render("##LargeFileViewer", ImGui::GetContentRegionAvail());
+            }
+            else if (m_bFileLoaded)
+            {
+                if (m_bShowFindBar)
+                {
+                    RenderFindBar();
+                }
+
                 // Render the text editor with syntax highlighting
                 // Get available space
                 ImVec2 available_size = ImGui::GetContentRegionAvail();
@@ -1338,39 +1528,53 @@ void FileExplorerApp::RenderFileViewer(float menu_bar_height)
                 if (m_TextEditor.IsTextChanged())
                 {
                     m_bFileModified = true;
+                    ++m_EditRevision;
                 }
             }
         }
 		
-        // Handle image files (unchanged)
-        else if (ranges::contains(m_SupportedImgTypes, file_ext))
+        // Handle image files
+        else if (file_type.file_class == e_FileClass::IMAGE)
         {
             // Only load texture if it's a different file or not loaded yet
             if (!m_bImgLoaded || m_LoadedImgPath != m_SelectedFile)
             {
-                // Unload previous texture if one was loaded
-                if (m_bImgLoaded && m_ImgTexture.id != 0)
+                // A load for an image that is no longer selected is dropped
+                if (m_ImgLoadResult && m_LoadingImgPath != m_SelectedFile)
                 {
-                    UnloadTexture(m_ImgTexture);
+                    CancelImageLoad();
                 }
 
-                // Try to load the new image
-                Image img = LoadImage(m_SelectedFile.string().c_str());
-                if (img.data != nullptr)
+                if (!m_ImgLoadResult)
                 {
-                    m_ImgTexture = LoadTextureFromImage(img);
+                    // Unload previous texture if one was loaded
+                    if (m_bImgLoaded && m_ImgTexture.id != 0)
+                    {
+                        UnloadTexture(m_ImgTexture);
+                    }
+                    m_bImgLoaded = false;
+                    m_LoadedImgPath = fs::path();
+
+                    StartImageLoad();
+                }
 
-                    // Free the image data, keep only the texture
-                    UnloadImage(img); 
-                    m_bImgLoaded = true;
-                    m_LoadedImgPath = m_SelectedFile;
+                UpdateImageLoad();
+            }
+
+            if (m_ImgLoadResult)
+            {
+                if (m_ImgLoadJob)
+                {
+                    ImGui::ProgressBar(-1.0f * static_cast<float>(ImGui::GetTime()), ImVec2(-1.0f, 0.0f), "Decoding...");
                 }
                 else
                 {
-                    m_ErrorMessage = "Failed to load image: " 
-                                   + m_SelectedFile.filename().string();
-                    m_bShowErrorPopup = true;
-                    m_bImgLoaded = false;
+                    ImGui::ProgressBar
+                    (
+                        static_cast<float>(m_ImgUploadedRows) / static_cast<float>(m_PendingImgTexture.height),
+                        ImVec2(-1.0f, 0.0f),
+                        "Uploading..."
+                    );
                 }
             }
             // Display the image if loaded successfully
@@ -1455,99 +1659,510 @@ void FileExplorerApp::RenderFileViewer(float menu_bar_height)
     }
 }
 
-// Function to format file sizes
-string FileExplorerApp::FormatSize(double size_in_bytes)
+// Function to re-read the current directory listing
+void FileExplorerApp::RefreshDirectory()
 {
-    constexpr std::array<string_view, 5> ce_UNITS =
+    if (current_path.empty())
     {
-        "B", "KB", "MB", "GB", "TB"
-    };
+        return;
+    }
 
-    std::size_t unit_idx = 0;
-    while (size_in_bytes >= 1024.0 && (unit_idx + 1) < ce_UNITS.size())
+    if (m_DirectoryModel.GetPath() != current_path)
+    {
+        m_DirectoryModel.Open(current_path);
+    }
+    else
     {
-        size_in_bytes /= 1024.0;
-        ++unit_idx;
+        m_DirectoryModel.Refresh();
     }
+}
 
-    return std::format("{:.2f} {}", size_in_bytes, ce_UNITS[unit_idx]);
+// Function to point the file watcher at the current and open file's directories
+void FileExplorerApp::UpdateWatches()
+{
+    vector<fs::path> directories;
+    if (!current_path.empty())
+    {
+        directories.push_back(current_path);
+    }
+
+    if (!m_SelectedFile.empty()
+        && m_SelectedFile.parent_path() != current_path)
+    {
+        directories.push_back(m_SelectedFile.parent_path());
+    }
+
+    m_FileWatcher.Watch(directories);
 }
 
-// Function to get files in a directory
-map<string, string> FileExplorerApp::GetFilesInDirectory(const fs::path& path)
+// Function to apply coalesced file system changes to the listing
+void FileExplorerApp::ProcessFileChanges()
 {
-    map<string, string> files;
-    if (fs::exists(path) && fs::is_directory(path))
+    // Above this a single rescan is cheaper than patching entry by entry
+    constexpr size_t ce_MAX_INCREMENTAL_CHANGES = 256;
+
+    static vector<FileWatcher::Change> s_Changes;
+    bool b_Rescan = false;
+    if (!m_FileWatcher.Poll(s_Changes, b_Rescan))
     {
-        for (const auto& ENTRY : fs::directory_iterator(path))
+        return;
+    }
+
+    bool b_FullRefresh = b_Rescan 
+        || s_Changes.size() > ce_MAX_INCREMENTAL_CHANGES;
+
+    if (b_FullRefresh)
+    {
+        RefreshDirectory();
+    }
+
+    bool b_SelectedFileTouched = b_Rescan;
+    for (const auto& CHANGE : s_Changes)
+    {
+        if (!b_FullRefresh && CHANGE.directory == current_path)
+        {
+            m_DirectoryModel.ApplyChange(CHANGE.name);
+        }
+
+        if (!m_SelectedFile.empty()
+            && CHANGE.directory == m_SelectedFile.parent_path()
+            && CHANGE.name == m_SelectedFile.filename().string())
+        {
+            b_SelectedFileTouched = true;
+        }
+    }
+
+    if (b_SelectedFileTouched)
+    {
+        CheckSelectedFileOnDisk();
+    }
+}
+
+// Function to check whether the open file was changed by someone else
+void FileExplorerApp::CheckSelectedFileOnDisk()
+{
+    if (m_SelectedFile.empty() || !m_bFileLoaded)
+    {
+        return;
+    }
+
+    // Our own save replacing the file is not someone else's change
+    if (IsSavingFile(m_SelectedFile))
+    {
+        return;
+    }
+
+    error_code ec;
+    auto write_time = fs::last_write_time(m_SelectedFile, ec);
+    if (ec || write_time != m_SelectedFileWriteTime)
+    {
+        m_bSelectedFileChangedOnDisk = true;
+    }
+
+    // Reading mapped pages past a new, shorter end of file faults, so a
+    // truncated large file (a rotated log) is re-mapped right away
+    if (m_LargeFileViewer.IsOpen())
+    {
+        uintmax_t size = fs::file_size(m_SelectedFile, ec);
+        if (ec || size < m_LargeFileViewer.GetFileSize())
+        {
+            m_LargeFileViewer.Close();
+            m_bFileLoaded = false;
+            m_bSelectedFileChangedOnDisk = false;
+        }
+    }
+}
+
+// Function to read the selected file on a worker thread. The job maps the
+// file and splits it into editor lines; the UI only swaps the result in.
+void FileExplorerApp::StartFileLoad()
+{
+    m_LargeFileViewer.Close();
+    m_LoadingFile = m_SelectedFile;
+
+    auto result = make_shared<FileLoadResult>();
+    m_FileLoadResult = result;
+    m_FileLoadJob = m_Jobs.Submit
+    (
+        [path = m_SelectedFile, result](JobHandle& job)
         {
-            if (ENTRY.is_regular_file())
+            // Parse straight out of the mapped pages, no intermediate buffer
+            MappedFile file;
+            if (!file.Open(path, result->error))
             {
-                string filename = ENTRY.path().filename().string();
-                string size_str = FormatSize(ENTRY.file_size());
-                files.emplace(filename, size_str);
+                return;
             }
-            else if (ENTRY.is_directory())
+
+            if (file.Size() > ce_MAX_BUFFER_SIZE)
             {
-                string dirname = ENTRY.path().filename().string();
-                files.emplace(dirname, "[D]");
+                result->b_TooLarge = true;
+                result->b_Ok = true;
+                return;
             }
+
+            result->lines = TextEditor::BuildLines
+            (
+                file.Data(),
+                file.Size(),
+                [&job](float progress)
+                {
+                    job.SetProgress(progress);
+                    return !job.IsCancelled();
+                }
+            );
+            result->b_Ok = !job.IsCancelled();
         }
+    );
+}
+
+// Function to hand a finished load over to the editor
+void FileExplorerApp::FinishFileLoad()
+{
+    shared_ptr<FileLoadResult> result = std::move(m_FileLoadResult);
+    m_FileLoadJob.reset();
+    m_FileLoadResult.reset();
+
+    if (!result->b_Ok)
+    {
+        m_ErrorMessage = "Could not open file: "
+                       + m_SelectedFile.string()
+                       + " (" + result->error + ")";
+        m_bShowErrorPopup = true;
+        return;
     }
 
-    return files;
+    if (result->b_TooLarge)
+    {
+        // Too big to edit, page through it read-only instead
+        string open_error;
+        if (m_LargeFileViewer.Open(m_SelectedFile, open_error))
+        {
+            m_TextEditor.SetText("");
+            m_bFileLoaded = true;
+            m_bFileModified = false;
+            RememberSelectedFileWriteTime();
+        }
+        else
+        {
+            m_ErrorMessage = "Could not open file: "
+                           + m_SelectedFile.string()
+                           + " (" + open_error + ")";
+            m_bShowErrorPopup = true;
+        }
+        return;
+    }
+
+    // Set text in the editor
+    m_TextEditor.SetLines(std::move(result->lines));
+    SetEditorLanguage(m_SelectedFile);
+
+    m_bFileLoaded = true;
+    m_bFileModified = false;
+    RememberSelectedFileWriteTime();
+}
+
+// Function to abandon an in-flight load, the worker stops at its next check
+void FileExplorerApp::CancelFileLoad()
+{
+    if (m_FileLoadJob)
+    {
+        m_FileLoadJob->Cancel();
+    }
+    m_FileLoadJob.reset();
+    m_FileLoadResult.reset();
+    m_LoadingFile.clear();
+}
+
+// Function to save the editor's text without holding up the frame. The job
+// gets its own copy of the text, one allocation and a memcpy, so editing
+// goes on while it is written; saves run one after another in order.
+void FileExplorerApp::StartFileSave(e_AfterSave after)
+{
+    auto text = make_shared<const string>(m_TextEditor.GetText());
+
+    FileSave save;
+    save.result = make_shared<FileSaveResult>();
+    save.file = m_SelectedFile;
+    save.revision = m_EditRevision;
+    save.after = after;
+    save.job = m_IoJobs.Submit
+    (
+        [path = m_SelectedFile, text, result = save.result](JobHandle&)
+        {
+            FileSaver saver;
+            if (!saver.Open(path, result->error))
+            {
+                return;
+            }
+
+            saver.Write(text->data(), text->size());
+            result->b_Ok = saver.Commit(result->error);
+        }
+    );
+    m_FileSaves.push_back(std::move(save));
+}
+
+// Function to take in the oldest finished save and carry on with what
+// waited on it
+void FileExplorerApp::FinishFileSave()
+{
+    FileSave save = std::move(m_FileSaves.front());
+    m_FileSaves.pop_front();
+
+    const shared_ptr<FileSaveResult>& result = save.result;
+    e_AfterSave after = save.after;
+
+    if (!result->b_Ok)
+    {
+        // Nothing that would drop the unsaved text goes ahead. An earlier
+        // failure still waiting to be seen is kept alongside this one.
+        string message = "Could not save file: "
+                       + save.file.string()
+                       + " (" + result->error + ")";
+        if (m_bShowErrorPopup || ImGui::IsPopupOpen("Error"))
+        {
+            m_ErrorMessage += "\n" + message;
+        }
+        else
+        {
+            m_ErrorMessage = message;
+        }
+        m_bShowErrorPopup = true;
+        m_PendingFileToOpen = fs::path();
+        m_PendingDirectoryToNavigate = fs::path();
+        return;
+    }
+
+    if (save.file == m_SelectedFile)
+    {
+        // Edits made while it was being written still need saving
+        if (m_EditRevision == save.revision)
+        {
+            m_bFileModified = false;
+        }
+        RememberSelectedFileWriteTime();
+    }
+
+    // Going on would drop edits made while the file was being written, so
+    // ask again instead; the pending file or directory is kept for that
+    if (m_EditRevision != save.revision)
+    {
+        if (after == e_AfterSave::EXIT)
+        {
+            m_bShowExitConfirm = true;
+        }
+        else if (after == e_AfterSave::OPEN_FILE)
+        {
+            m_bShowSaveBeforeOpenConfirm = true;
+        }
+        else if (after == e_AfterSave::CHANGE_DIRECTORY)
+        {
+            m_bShowSaveBeforeDirChangeConfirm = true;
+        }
+        return;
+    }
+
+    if (after == e_AfterSave::EXIT)
+    {
+        m_bExit = true;
+    }
+    else if (after == e_AfterSave::OPEN_FILE)
+    {
+        OpenFile(m_PendingFileToOpen);
+    }
+    else if (after == e_AfterSave::CHANGE_DIRECTORY)
+    {
+        NavigateToDirectory(m_PendingDirectoryToNavigate);
+        m_PendingDirectoryToNavigate = fs::path();
+    }
+}
+
+// Function to tell whether a save of file is still queued
+bool FileExplorerApp::IsSavingFile(const fs::path& file) const
+{
+    for (const FileSave& save : m_FileSaves)
+    {
+        if (save.file == file)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to decode the selected image on a worker thread. Only the GPU
+// upload, which must happen on the render thread, is left to the UI.
+void FileExplorerApp::StartImageLoad()
+{
+    m_LoadingImgPath = m_SelectedFile;
+    m_ImgUploadedRows = 0;
+
+    auto result = make_shared<ImageLoadResult>();
+    m_ImgLoadResult = result;
+    m_ImgLoadJob = m_Jobs.Submit
+    (
+        [path = m_SelectedFile, result](JobHandle& job)
+        {
+            Image img = LoadImage(path.string().c_str());
+            if (img.data == nullptr || job.IsCancelled())
+            {
+                UnloadImage(img);
+                return;
+            }
+
+            // One known layout, so the upload can slice it into rows
+            ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+            result->image = img;
+        }
+    );
+}
+
+// Function to move a decoded image to the GPU a strip of rows per frame
+void FileExplorerApp::UpdateImageLoad()
+{
+    if (!m_ImgLoadResult)
+    {
+        return;
+    }
+
+    if (m_ImgLoadJob)
+    {
+        if (!m_ImgLoadJob->IsDone())
+        {
+            return;
+        }
+        m_ImgLoadJob.reset();
+
+        const Image& IMG = m_ImgLoadResult->image;
+        if (IMG.data != nullptr)
+        {
+            // Allocate storage only, the pixels follow over the next frames
+            m_PendingImgTexture.id = rlLoadTexture(nullptr, IMG.width, IMG.height, IMG.format, 1);
+            m_PendingImgTexture.width = IMG.width;
+            m_PendingImgTexture.height = IMG.height;
+            m_PendingImgTexture.mipmaps = 1;
+            m_PendingImgTexture.format = IMG.format;
+        }
+
+        if (m_PendingImgTexture.id == 0)
+        {
+            m_ErrorMessage = "Failed to load image: " 
+                           + m_LoadingImgPath.filename().string();
+            m_bShowErrorPopup = true;
+            CancelImageLoad();
+            return;
+        }
+    }
+
+    const Image& IMG = m_ImgLoadResult->image;
+    int row_bytes = IMG.width * 4;
+    int rows = max(1, ce_IMG_UPLOAD_BYTES_PER_FRAME / row_bytes);
+    rows = min(rows, IMG.height - m_ImgUploadedRows);
+
+    UpdateTextureRec
+    (
+        m_PendingImgTexture,
+        Rectangle
+        {
+            0.0f,
+            static_cast<float>(m_ImgUploadedRows),
+            static_cast<float>(IMG.width),
+            static_cast<float>(rows)
+        },
+        static_cast<const unsigned char*>(IMG.data) + static_cast<size_t>(m_ImgUploadedRows) * row_bytes
+    );
+    m_ImgUploadedRows += rows;
+
+    if (m_ImgUploadedRows < IMG.height)
+    {
+        return;
+    }
+
+    // Fully uploaded, the CPU copy is released with the result
+    m_ImgTexture = m_PendingImgTexture;
+    m_PendingImgTexture = { 0 };
+    m_bImgLoaded = true;
+    m_LoadedImgPath = m_LoadingImgPath;
+    m_ImgLoadResult.reset();
+    m_LoadingImgPath.clear();
+}
+
+// Function to abandon an image that is still decoding or uploading
+void FileExplorerApp::CancelImageLoad()
+{
+    if (m_ImgLoadJob)
+    {
+        m_ImgLoadJob->Cancel();
+    }
+    m_ImgLoadJob.reset();
+    m_ImgLoadResult.reset();
+    m_LoadingImgPath.clear();
+    m_ImgUploadedRows = 0;
+
+    if (m_PendingImgTexture.id != 0)
+    {
+        UnloadTexture(m_PendingImgTexture);
+    }
+    m_PendingImgTexture = { 0 };
+}
+
+// Function to unmap a large file before it is renamed or deleted, Windows
+// refuses both while a mapping is open
+void FileExplorerApp::ReleaseLargeFile()
+{
+    if (m_LargeFileViewer.IsOpen())
+    {
+        // Reloaded on the next frame if it is still selected
+        m_LargeFileViewer.Close();
+        m_bFileLoaded = false;
+    }
+}
+
+// Function to remember the open file's timestamp after a load or save
+void FileExplorerApp::RememberSelectedFileWriteTime()
+{
+    error_code ec;
+    m_SelectedFileWriteTime = fs::last_write_time(m_SelectedFile, ec);
+    m_bSelectedFileChangedOnDisk = false;
 }
 
 // Helper function to determine language from file extension
 const TextEditor::LanguageDefinition& FileExplorerApp::GetLanguageDefinition
 (
-    const string& extension
+    e_Language language
 )
 {
     static const TextEditor::LanguageDefinition& default_lang = TextEditor::LanguageDefinition::CPlusPlus();
     
-    if 
-    (
-        extension == ".cpp" || 
-        extension == ".h"   || 
-        extension == ".hpp" || 
-        extension == ".cxx" || 
-        extension == ".hxx"
-    )
+    if (language == e_Language::CPLUSPLUS)
     {
         return TextEditor::LanguageDefinition::CPlusPlus();
     }
-    else if (extension == ".c")
+    else if (language == e_Language::C)
     {
         return TextEditor::LanguageDefinition::C();
     }
-    else if (extension == ".hlsl" || extension == ".fx")
+    else if (language == e_Language::HLSL)
     {
         return TextEditor::LanguageDefinition::HLSL();
     }
-    else if 
-    (
-        extension == ".glsl" || 
-        extension == ".vert" || 
-        extension == ".frag" || 
-        extension == ".geom"
-    )
+    else if (language == e_Language::GLSL)
     {
         return TextEditor::LanguageDefinition::GLSL();
     }
-    else if (extension == ".sql")
+    else if (language == e_Language::SQL)
     {
         return TextEditor::LanguageDefinition::SQL();
     }
-    else if (extension == ".as")
+    else if (language == e_Language::ANGELSCRIPT)
     {
         return TextEditor::LanguageDefinition::AngelScript();
     }
-    else if (extension == ".lua")
+    else if (language == e_Language::LUA)
     {
         return TextEditor::LanguageDefinition::Lua();
     }
-    else if (extension == ".py")
+    else if (language == e_Language::PYTHON)
     {
         // Python-like highlighting (we'll use C++ as base for now)
         static TextEditor::LanguageDefinition python_lang = TextEditor::LanguageDefinition::CPlusPlus();
@@ -1557,14 +2172,14 @@ const TextEditor::LanguageDefinition& FileExplorerApp::GetLanguageDefinition
         python_lang.mSingleLineComment = "#";
         return python_lang;
     }
-    else if (extension == ".js" || extension == ".ts" || extension == ".tsx")
+    else if (language == e_Language::JAVASCRIPT)
     {
         // JavaScript/TypeScript (use C++ as base)
         static TextEditor::LanguageDefinition js_lang = TextEditor::LanguageDefinition::CPlusPlus();
         js_lang.mName = "JavaScript";
         return js_lang;
     }
-    else if (extension == ".html" || extension == ".htm")
+    else if (language == e_Language::HTML)
     {
         // HTML (use C++ as base)
         static TextEditor::LanguageDefinition html_lang = TextEditor::LanguageDefinition::CPlusPlus();
@@ -1572,7 +2187,7 @@ const TextEditor::LanguageDefinition& FileExplorerApp::GetLanguageDefinition
         html_lang.mSingleLineComment = "<!--";
         return html_lang;
     }
-    else if (extension == ".css")
+    else if (language == e_Language::CSS)
     {
         // CSS (use C++ as base)
         static TextEditor::LanguageDefinition css_lang = TextEditor::LanguageDefinition::CPlusPlus();
@@ -1580,20 +2195,20 @@ const TextEditor::LanguageDefinition& FileExplorerApp::GetLanguageDefinition
         css_lang.mSingleLineComment = "/*";
         return css_lang;
     }
-    else if (extension == ".java")
+    else if (language == e_Language::JAVA)
     {
         static TextEditor::LanguageDefinition java_lang = TextEditor::LanguageDefinition::CPlusPlus();
         java_lang.mName = "Java";
         return java_lang;
     }
-    else if (extension == ".rs")
+    else if (language == e_Language::RUST)
     {
         static TextEditor::LanguageDefinition rust_lang = TextEditor::LanguageDefinition::CPlusPlus();
         rust_lang.mName = "Rust";
         rust_lang.mSingleLineComment = "//";
         return rust_lang;
     }
-    else if (extension == ".go")
+    else if (language == e_Language::GO)
     {
         static TextEditor::LanguageDefinition go_lang = TextEditor::LanguageDefinition::CPlusPlus();
         go_lang.mName = "Go";
@@ -1615,17 +2230,25 @@ void FileExplorerApp::OpenFile(const fs::path &file_path)
     }
     
     m_SelectedFile = file_path;
+    CancelFileLoad();
+    CancelImageLoad();
+    m_LargeFileViewer.Close();
     m_bFileLoaded = false;
     m_bFileModified = false;
+    m_bSelectedFileChangedOnDisk = false;
     m_TextEditor.SetText("");
     
     // Clear the pending file
     m_PendingFileToOpen = fs::path();
+
+    // Follow the open file's directory as well
+    UpdateWatches();
 }
 
 void FileExplorerApp::NavigateToDirectory(const fs::path &new_path)
 {
     current_path = new_path;
+    m_DirectoryModel.Open(current_path);
     
     // Clean up any loaded resources
     if (m_bImgLoaded && m_ImgTexture.id != 0)
@@ -1635,18 +2258,21 @@ void FileExplorerApp::NavigateToDirectory(const fs::path &new_path)
         m_LoadedImgPath = fs::path();
     }
     m_SelectedFile = fs::path();
+    CancelFileLoad();
+    CancelImageLoad();
+    m_LargeFileViewer.Close();
     m_bFileLoaded = false;
     m_bFileModified = false;
+    m_bSelectedFileChangedOnDisk = false;
     m_TextEditor.SetText("");
+
+    UpdateWatches();
 }
 
 // Helper function to set editor language based on file extension
 void FileExplorerApp::SetEditorLanguage(const fs::path& filePath)
 {
-    string ext = filePath.extension().string();
-    
-    // Convert to lowercase for comparison ( Used direct ascii for ultimate speed )
-    std::ranges::for_each(ext, [](char& c) { if (c >= 'A' && c <= 'Z') c += 32; });
+    string ext = ToLowerExtension(filePath.filename().string());
 
-    m_TextEditor.SetLanguageDefinition(GetLanguageDefinition(ext));
+    m_TextEditor.SetLanguageDefinition(GetLanguageDefinition(m_FileTypes.Lookup(ext).language));
 }
\ No newline at end of file
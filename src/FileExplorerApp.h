@@ -8,15 +8,26 @@
 #include <rlImGui.h>
 #include <imfilebrowser.h>
 #include <map>
+#include <deque>
 #include <string>
 #include <vector>
 #include <misc/cpp/imgui_stdlib.h>
 #include <ranges>
 #include "TextEditor.h" 
+#include "DirectoryModel.h"
+#include "FileWatcher.h"
+#include "FileTypes.h"
+#include "MappedFile.h"
+#include "FileSaver.h"
+#include "LargeFileViewer.h"
+#include "JobSystem.h"
 using namespace std;
 namespace fs = std::filesystem;
 constexpr int ce_MAX_BUFFER_SIZE = 5 * 1024 * 1024; // 5MB buffer
 
+// What to do once a save has gone through
+enum class e_AfterSave : uint8_t { NOTHING, EXIT, OPEN_FILE, CHANGE_DIRECTORY };
+
 class FileExplorerApp
 {
 public:
@@ -50,6 +61,12 @@ private:
     // Function to process saving a file
     void ProcessSaveFile(bool& b_Save);
 
+    // Functions to save the editor's text on the I/O thread, then do what
+    // was waiting on the save
+    void StartFileSave(e_AfterSave after);
+    void FinishFileSave();
+    bool IsSavingFile(const fs::path& file) const;
+
     // Function to handle error popups
     void HandleErrorPopup();
 
@@ -82,30 +99,110 @@ private:
     // Function to render the file viewer/editor with syntax highlighting
     void RenderFileViewer(float menu_bar_height);
 
-    // Function to format file sizes
-    string FormatSize(double size_in_bytes);
+    // Function to render the find and replace bar above the text editor
+    void RenderFindBar();
+
+    // Function to re-read the current directory listing
+    void RefreshDirectory();
+
+    // Function to point the file watcher at the current and open file's directories
+    void UpdateWatches();
+
+    // Function to apply coalesced file system changes to the listing
+    void ProcessFileChanges();
+
+    // Function to check whether the open file was changed by someone else
+    void CheckSelectedFileOnDisk();
 
-    // Function to get files in a directory
-    map<string, string> GetFilesInDirectory(const fs::path& path);
+    // Function to remember the open file's timestamp after a load or save
+    void RememberSelectedFileWriteTime();
+
+    // Function to unmap a large file before it is renamed or deleted
+    void ReleaseLargeFile();
+
+    // Functions to load the selected text file in the background
+    void StartFileLoad();
+    void FinishFileLoad();
+    void CancelFileLoad();
+
+    // Functions to decode the selected image in the background
+    void StartImageLoad();
+    void UpdateImageLoad();
+    void CancelImageLoad();
 
     // Helper functions
     void SetEditorLanguage(const fs::path& filePath);
-    const TextEditor::LanguageDefinition& GetLanguageDefinition(const string& extension);
+    const TextEditor::LanguageDefinition& GetLanguageDefinition(e_Language language);
     void OpenFile(const fs::path& file_path);
     void NavigateToDirectory(const fs::path& new_path);
 
 private:
-    
+    // Filled in by a load job, read by the UI once the job is done
+    struct FileLoadResult
+    {
+        TextEditor::Lines lines;
+        bool b_Ok = false;
+        bool b_TooLarge = false;
+        string error;
+    };
+
+    // Filled in by a save job, read by the UI once the job is done
+    struct FileSaveResult
+    {
+        bool b_Ok = false;
+        string error;
+    };
+
+    // A save in flight and what waits on it
+    struct FileSave
+    {
+        shared_ptr<JobHandle> job;
+        shared_ptr<FileSaveResult> result;
+        fs::path file;
+        uint64_t revision = 0;
+        e_AfterSave after = e_AfterSave::NOTHING;
+    };
+
+    // Decoded pixels, freed with the result even if nobody collects them
+    struct ImageLoadResult
+    {
+        Image image = { 0 };
+
+        ~ImageLoadResult()
+        {
+            if (image.data != nullptr)
+            {
+                UnloadImage(image);
+            }
+        }
+    };
+
+    JobSystem m_Jobs;
+
+    // Saves get a thread of their own so a slow disk never holds up loads,
+    // and run one at a time in the order they were made
+    JobSystem m_IoJobs{ 1 };
+    deque<FileSave> m_FileSaves;    // oldest first
+    shared_ptr<JobHandle> m_FileLoadJob;
+    shared_ptr<FileLoadResult> m_FileLoadResult;
+    fs::path m_LoadingFile;
+
     TextEditor m_TextEditor; 
+    LargeFileViewer m_LargeFileViewer;
     ImGui::FileBrowser m_FileBrowser;
     fs::path current_path;
+    DirectoryModel m_DirectoryModel;
+    FileWatcher m_FileWatcher;
     fs::path m_SelectedFile;
     bool m_bFileLoaded;
     bool m_bFileModified;
+    uint64_t m_EditRevision;        // bumped on every edit, tells a save whether it is still current
     bool m_bExit;
     bool m_bShowExitConfirm;
     bool m_bShowSaveBeforeOpenConfirm;
     bool m_bShowSaveBeforeDirChangeConfirm;
+    bool m_bSelectedFileChangedOnDisk;
+    fs::file_time_type m_SelectedFileWriteTime;
 
     Texture2D m_FileIcon;
     Texture2D m_FolderIcon;
@@ -115,16 +212,28 @@ private:
     Texture2D m_ImgTexture;
     bool m_bImgLoaded;
     fs::path m_LoadedImgPath;
+    shared_ptr<JobHandle> m_ImgLoadJob;
+    shared_ptr<ImageLoadResult> m_ImgLoadResult;
+    fs::path m_LoadingImgPath;
+    Texture2D m_PendingImgTexture;
+    int m_ImgUploadedRows;
     fs::path m_PendingFileToOpen;
     fs::path m_PendingDirectoryToNavigate;
 
+    // Find bar over the text editor
+    bool m_bShowFindBar;
+    bool m_bFocusFindInput;
+    bool m_bFindMatchCase;
+    bool m_bFindRegex;
+    string m_FindQuery;
+    string m_ReplaceText;
+
     bool m_bShowSaveDialog;
     bool m_bShowErrorPopup;
     string m_ErrorMessage;
     float m_SideMenuWidth;
 
-    // Arrays to track supported file types
-    array<string, 33> m_SupportedFileTypes;
-    array<string, 3> m_SupportedImgTypes;
+    // Extension to icon / viewer / language lookup
+    FileTypeRegistry m_FileTypes;
     unordered_map<string, TextEditor::LanguageDefinition> m_LanguageDefinitions;
 };	
\ No newline at end of file
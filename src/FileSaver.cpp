@@ -0,0 +1,313 @@
+#include "FileSaver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+// Platform headers stay in this file, windows.h clashes with raylib.h
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t ce_SAVE_BUFFER_SIZE = 1024 * 1024; // 1MB per write
+constexpr int ce_MAX_TEMP_ATTEMPTS = 100;
+
+FileSaver::~FileSaver()
+{
+    Discard();
+}
+
+// Function to name the temporary file, hidden next to the target so the
+// final rename never crosses a file system
+static fs::path TempPathFor(const fs::path& target, int attempt)
+{
+    return target.parent_path() / ("." + target.filename().string() + ".save" + std::to_string(attempt));
+}
+
+bool FileSaver::Write(const char* data, size_t size)
+{
+    if (!m_Error.empty() || m_TempPath.empty())
+    {
+        return false;
+    }
+
+    while (size > 0)
+    {
+        size_t chunk = std::min(size, m_Buffer.size() - m_Used);
+        memcpy(m_Buffer.data() + m_Used, data, chunk);
+        m_Used += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (m_Used == m_Buffer.size() && !Flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FileSaver::Discard()
+{
+    CloseFile();
+    if (!m_TempPath.empty())
+    {
+        std::error_code ec;
+        fs::remove(m_TempPath, ec);
+    }
+    m_Path.clear();
+    m_TempPath.clear();
+    m_Buffer = std::vector<char>();
+    m_Used = 0;
+    m_Error.clear();
+}
+
+#if defined(_WIN32)
+
+static std::string LastErrorMessage()
+{
+    char buffer[256] = {};
+    FormatMessageA
+    (
+        FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        nullptr,
+        GetLastError(),
+        0,
+        buffer,
+        sizeof(buffer),
+        nullptr
+    );
+    return buffer;
+}
+
+bool FileSaver::Open(const fs::path& path, std::string& error)
+{
+    Discard();
+
+    // Replace what a link points at rather than the link itself
+    std::error_code ec;
+    m_Path = fs::is_symlink(path, ec) ? fs::canonical(path, ec) : path;
+    if (ec)
+    {
+        m_Path = path;
+    }
+
+    for (int attempt = 0; attempt < ce_MAX_TEMP_ATTEMPTS; ++attempt)
+    {
+        fs::path temp_path = TempPathFor(m_Path, attempt);
+        HANDLE file = CreateFileW
+        (
+            temp_path.c_str(),
+            GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_NEW,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr
+        );
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            m_File = file;
+            m_TempPath = temp_path;
+            m_Buffer.resize(ce_SAVE_BUFFER_SIZE);
+            return true;
+        }
+        if (GetLastError() != ERROR_FILE_EXISTS)
+        {
+            break;
+        }
+    }
+
+    error = LastErrorMessage();
+    m_Path.clear();
+    return false;
+}
+
+bool FileSaver::Flush()
+{
+    const char* data = m_Buffer.data();
+    size_t size = m_Used;
+    while (size > 0)
+    {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(m_File), data, chunk, &written, nullptr))
+        {
+            m_Error = LastErrorMessage();
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    m_Used = 0;
+    return true;
+}
+
+bool FileSaver::Commit(std::string& error)
+{
+    if (m_TempPath.empty())
+    {
+        error = "Nothing to save";
+        return false;
+    }
+
+    if (m_Error.empty() && Flush() && !FlushFileBuffers(static_cast<HANDLE>(m_File)))
+    {
+        m_Error = LastErrorMessage();
+    }
+    CloseFile();
+
+    if (m_Error.empty()
+        && !MoveFileExW(m_TempPath.c_str(), m_Path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        m_Error = LastErrorMessage();
+    }
+
+    if (!m_Error.empty())
+    {
+        error = m_Error;
+        Discard();
+        return false;
+    }
+
+    m_TempPath.clear();
+    Discard();
+    return true;
+}
+
+void FileSaver::CloseFile()
+{
+    if (m_File != nullptr)
+    {
+        CloseHandle(static_cast<HANDLE>(m_File));
+    }
+    m_File = nullptr;
+}
+
+#else
+
+bool FileSaver::Open(const fs::path& path, std::string& error)
+{
+    Discard();
+
+    // Replace what a link points at rather than the link itself
+    std::error_code ec;
+    m_Path = fs::is_symlink(path, ec) ? fs::canonical(path, ec) : path;
+    if (ec)
+    {
+        m_Path = path;
+    }
+
+    for (int attempt = 0; attempt < ce_MAX_TEMP_ATTEMPTS; ++attempt)
+    {
+        fs::path temp_path = TempPathFor(m_Path, attempt);
+        int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0)
+        {
+            // Keep the permissions of the file being replaced
+            struct stat info = {};
+            if (stat(m_Path.c_str(), &info) == 0)
+            {
+                fchmod(fd, info.st_mode & 07777);
+            }
+
+            m_File = fd;
+            m_TempPath = temp_path;
+            m_Buffer.resize(ce_SAVE_BUFFER_SIZE);
+            return true;
+        }
+        if (errno != EEXIST)
+        {
+            break;
+        }
+    }
+
+    error = std::strerror(errno);
+    m_Path.clear();
+    return false;
+}
+
+bool FileSaver::Flush()
+{
+    const char* data = m_Buffer.data();
+    size_t size = m_Used;
+    while (size > 0)
+    {
+        ssize_t written = write(m_File, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            m_Error = std::strerror(errno);
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    m_Used = 0;
+    return true;
+}
+
+bool FileSaver::Commit(std::string& error)
+{
+    if (m_TempPath.empty())
+    {
+        error = "Nothing to save";
+        return false;
+    }
+
+    if (m_Error.empty() && Flush() && fsync(m_File) != 0)
+    {
+        m_Error = std::strerror(errno);
+    }
+    if (m_File >= 0 && close(m_File) != 0 && m_Error.empty())
+    {
+        m_Error = std::strerror(errno);
+    }
+    m_File = -1;
+
+    if (m_Error.empty() && rename(m_TempPath.c_str(), m_Path.c_str()) != 0)
+    {
+        m_Error = std::strerror(errno);
+    }
+
+    if (!m_Error.empty())
+    {
+        error = m_Error;
+        Discard();
+        return false;
+    }
+
+    // Make the rename itself survive a crash
+    fs::path directory = m_Path.parent_path().empty() ? fs::path(".") : m_Path.parent_path();
+    int dir_fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    m_TempPath.clear();
+    Discard();
+    return true;
+}
+
+void FileSaver::CloseFile()
+{
+    if (m_File >= 0)
+    {
+        close(m_File);
+    }
+    m_File = -1;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Writes a new version of a file without ever leaving it half written. The
+// data is streamed into a temporary file in the same directory through a
+// large buffer, flushed to disk, and only then renamed over the target, so
+// after a crash the old or the new contents are there, never a truncated
+// mix. Until Commit() succeeds the target is not touched, and an unfinished
+// save is discarded when the saver goes away.
+class FileSaver
+{
+public:
+    FileSaver() = default;
+    ~FileSaver();
+
+    FileSaver(const FileSaver&) = delete;
+    FileSaver& operator=(const FileSaver&) = delete;
+
+    // Function to create the temporary file next to path
+    bool Open(const fs::path& path, std::string& error);
+
+    // Function to append data. Returns false once a write has failed, the
+    // reason is reported by Commit().
+    bool Write(const char* data, size_t size);
+
+    // Function to flush everything to disk and move it over the target
+    bool Commit(std::string& error);
+
+    // Function to delete the temporary file and leave the target as it was
+    void Discard();
+
+private:
+    bool Flush();
+    void CloseFile();
+
+    fs::path m_Path;
+    fs::path m_TempPath;
+    std::vector<char> m_Buffer;
+    size_t m_Used = 0;
+    std::string m_Error;
+
+#if defined(_WIN32)
+    void* m_File = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
@@ -0,0 +1,229 @@
+#include "FileTypes.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    struct BuiltinType
+    {
+        std::string_view extension;
+        FileTypeInfo info;
+    };
+
+    constexpr FileTypeInfo Text(e_Language language = e_Language::DEFAULT)
+    {
+        return { e_FileClass::TEXT, language };
+    }
+
+    constexpr FileTypeInfo ce_IMAGE = { e_FileClass::IMAGE, e_Language::DEFAULT };
+
+    // Must stay sorted, checked below
+    constexpr std::array ce_BUILTIN_TYPES =
+    {
+        BuiltinType{ ".as",    Text(e_Language::ANGELSCRIPT) },
+        BuiltinType{ ".bat",   Text() },
+        BuiltinType{ ".bmp",   ce_IMAGE },
+        BuiltinType{ ".c",     Text(e_Language::C) },
+        BuiltinType{ ".cpp",   Text(e_Language::CPLUSPLUS) },
+        BuiltinType{ ".css",   Text(e_Language::CSS) },
+        BuiltinType{ ".cxx",   Text(e_Language::CPLUSPLUS) },
+        BuiltinType{ ".dart",  Text() },
+        BuiltinType{ ".frag",  Text(e_Language::GLSL) },
+        BuiltinType{ ".fx",    Text(e_Language::HLSL) },
+        BuiltinType{ ".geom",  Text(e_Language::GLSL) },
+        BuiltinType{ ".glsl",  Text(e_Language::GLSL) },
+        BuiltinType{ ".go",    Text(e_Language::GO) },
+        BuiltinType{ ".h",     Text(e_Language::CPLUSPLUS) },
+        BuiltinType{ ".hlsl",  Text(e_Language::HLSL) },
+        BuiltinType{ ".hpp",   Text(e_Language::CPLUSPLUS) },
+        BuiltinType{ ".htm",   Text(e_Language::HTML) },
+        BuiltinType{ ".html",  Text(e_Language::HTML) },
+        BuiltinType{ ".hxx",   Text(e_Language::CPLUSPLUS) },
+        BuiltinType{ ".ini",   Text() },
+        BuiltinType{ ".java",  Text(e_Language::JAVA) },
+        BuiltinType{ ".jpg",   ce_IMAGE },
+        BuiltinType{ ".js",    Text(e_Language::JAVASCRIPT) },
+        BuiltinType{ ".json",  Text() },
+        BuiltinType{ ".kt",    Text() },
+        BuiltinType{ ".log",   Text() },
+        BuiltinType{ ".lua",   Text(e_Language::LUA) },
+        BuiltinType{ ".md",    Text() },
+        BuiltinType{ ".php",   Text() },
+        BuiltinType{ ".pl",    Text() },
+        BuiltinType{ ".png",   ce_IMAGE },
+        BuiltinType{ ".py",    Text(e_Language::PYTHON) },
+        BuiltinType{ ".r",     Text() },
+        BuiltinType{ ".rb",    Text() },
+        BuiltinType{ ".rs",    Text(e_Language::RUST) },
+        BuiltinType{ ".scala", Text() },
+        BuiltinType{ ".sh",    Text() },
+        BuiltinType{ ".sql",   Text(e_Language::SQL) },
+        BuiltinType{ ".swift", Text() },
+        BuiltinType{ ".ts",    Text(e_Language::JAVASCRIPT) },
+        BuiltinType{ ".tsx",   Text(e_Language::JAVASCRIPT) },
+        BuiltinType{ ".txt",   Text() },
+        BuiltinType{ ".vert",  Text(e_Language::GLSL) },
+        BuiltinType{ ".vue",   Text() },
+        BuiltinType{ ".xml",   Text() },
+        BuiltinType{ ".yaml",  Text() }
+    };
+
+    static_assert
+    (
+        std::ranges::is_sorted(ce_BUILTIN_TYPES, {}, &BuiltinType::extension),
+        "ce_BUILTIN_TYPES must be sorted by extension"
+    );
+
+    struct LanguageName
+    {
+        std::string_view name;
+        e_Language language;
+    };
+
+    constexpr std::array ce_LANGUAGE_NAMES =
+    {
+        LanguageName{ "default",     e_Language::DEFAULT },
+        LanguageName{ "cpp",         e_Language::CPLUSPLUS },
+        LanguageName{ "c",           e_Language::C },
+        LanguageName{ "hlsl",        e_Language::HLSL },
+        LanguageName{ "glsl",        e_Language::GLSL },
+        LanguageName{ "sql",         e_Language::SQL },
+        LanguageName{ "angelscript", e_Language::ANGELSCRIPT },
+        LanguageName{ "lua",         e_Language::LUA },
+        LanguageName{ "python",      e_Language::PYTHON },
+        LanguageName{ "javascript",  e_Language::JAVASCRIPT },
+        LanguageName{ "html",        e_Language::HTML },
+        LanguageName{ "css",         e_Language::CSS },
+        LanguageName{ "java",        e_Language::JAVA },
+        LanguageName{ "rust",        e_Language::RUST },
+        LanguageName{ "go",          e_Language::GO }
+    };
+}
+
+// ASCII only, extensions are matched byte-wise
+static void ToLower(std::string& text)
+{
+    for (char& c : text)
+    {
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+}
+
+std::string ToLowerExtension(std::string_view file_name)
+{
+    size_t dot = file_name.rfind('.');
+    if (dot == std::string_view::npos || dot == 0 || file_name == "..")
+    {
+        return {};
+    }
+
+    std::string extension(file_name.substr(dot));
+    ToLower(extension);
+    return extension;
+}
+
+FileTypeInfo FileTypeRegistry::Lookup(std::string_view extension) const
+{
+    if (!m_Overrides.empty())
+    {
+        auto it = std::ranges::lower_bound(m_Overrides, extension, {}, &Override::extension);
+        if (it != m_Overrides.end() && it->extension == extension)
+        {
+            return it->info;
+        }
+    }
+
+    auto it = std::ranges::lower_bound(ce_BUILTIN_TYPES, extension, {}, &BuiltinType::extension);
+    if (it != ce_BUILTIN_TYPES.end() && it->extension == extension)
+    {
+        return it->info;
+    }
+    return {};
+}
+
+bool FileTypeRegistry::LoadConfig(const fs::path& path, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return true;
+    }
+
+    bool b_Ok = true;
+    auto report = [&](int line_number, const std::string& message)
+    {
+        if (b_Ok)
+        {
+            error = path.string() + ":" + std::to_string(line_number) + ": " + message;
+            b_Ok = false;
+        }
+    };
+
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); ++line_number)
+    {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string extension;
+        std::string kind;
+        std::string language;
+        if (!(fields >> extension))
+        {
+            continue; // Blank or comment
+        }
+        fields >> kind >> language;
+
+        if (extension.size() < 2 || extension[0] != '.')
+        {
+            report(line_number, "expected an extension such as .txt");
+            continue;
+        }
+
+        ToLower(extension);
+
+        Override entry{ extension, {} };
+        if (kind == "text")
+        {
+            entry.info.file_class = e_FileClass::TEXT;
+        }
+        else if (kind == "image")
+        {
+            entry.info.file_class = e_FileClass::IMAGE;
+        }
+        else if (kind != "none")
+        {
+            report(line_number, "unknown kind '" + kind + "', expected text, image or none");
+            continue;
+        }
+
+        if (!language.empty())
+        {
+            auto it = std::ranges::find(ce_LANGUAGE_NAMES, language, &LanguageName::name);
+            if (it == ce_LANGUAGE_NAMES.end())
+            {
+                report(line_number, "unknown language '" + language + "'");
+                continue;
+            }
+            entry.info.language = it->language;
+        }
+
+        auto it = std::ranges::lower_bound(m_Overrides, entry.extension, {}, &Override::extension);
+        if (it != m_Overrides.end() && it->extension == entry.extension)
+        {
+            it->info = entry.info;
+        }
+        else
+        {
+            m_Overrides.insert(it, std::move(entry));
+        }
+    }
+
+    return b_Ok;
+}
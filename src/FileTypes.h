@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// What a file is opened as, this also picks its icon in the explorer panel
+enum class e_FileClass : uint8_t { OTHER, TEXT, IMAGE };
+
+// Syntax highlighting for text files. DEFAULT is the editor's fallback.
+enum class e_Language : uint8_t
+{
+    DEFAULT,
+    CPLUSPLUS,
+    C,
+    HLSL,
+    GLSL,
+    SQL,
+    ANGELSCRIPT,
+    LUA,
+    PYTHON,
+    JAVASCRIPT,
+    HTML,
+    CSS,
+    JAVA,
+    RUST,
+    GO
+};
+
+struct FileTypeInfo
+{
+    e_FileClass file_class = e_FileClass::OTHER;
+    e_Language language = e_Language::DEFAULT;
+};
+
+// Function to get the lower-case extension of a file name, with the same
+// rules as fs::path::extension() (".bashrc" has none)
+std::string ToLowerExtension(std::string_view file_name);
+
+// Maps extensions to how the file is shown. The built-in types are a sorted
+// compile-time table searched with a binary search; a config file can add
+// or override extensions at startup. Lookups are read-only, so a copy can
+// be handed to a worker thread.
+class FileTypeRegistry
+{
+public:
+    // Function to look up a lower-case extension such as ".png"
+    FileTypeInfo Lookup(std::string_view extension) const;
+
+    // Function to read "<.ext> <text|image|none> [language]" lines. A missing
+    // file is not an error; on a bad line the rest is still read and the
+    // first problem is reported through error.
+    bool LoadConfig(const fs::path& path, std::string& error);
+
+private:
+    struct Override
+    {
+        std::string extension;
+        FileTypeInfo info;
+    };
+
+    // Sorted by extension
+    std::vector<Override> m_Overrides;
+};
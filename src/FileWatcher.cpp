@@ -0,0 +1,245 @@
+#include "FileWatcher.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Quiet period before a batch is handed out, and the longest a batch may be
+// held back while events keep streaming in
+constexpr auto ce_COALESCE_QUIET = std::chrono::milliseconds(150);
+constexpr auto ce_COALESCE_MAX_DELAY = std::chrono::milliseconds(1000);
+
+// Past this many distinct entries a rescan is cheaper than applying deltas
+constexpr size_t ce_MAX_PENDING_CHANGES = 4096;
+
+FileWatcher::FileWatcher()
+    : m_Fd(-1)
+    , m_bRescan(false)
+{
+#if defined(__linux__)
+    m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    Clear();
+#if defined(__linux__)
+    if (m_Fd >= 0)
+    {
+        close(m_Fd);
+    }
+#endif
+}
+
+void FileWatcher::Watch(const std::vector<fs::path>& directories)
+{
+    Clear();
+
+#if defined(__linux__)
+    if (m_Fd < 0)
+    {
+        return;
+    }
+
+    constexpr uint32_t ce_MASK =
+        IN_CREATE      |
+        IN_DELETE      |
+        IN_MOVED_FROM  |
+        IN_MOVED_TO    |
+        IN_MODIFY      |
+        IN_CLOSE_WRITE |
+        IN_ATTRIB      |
+        IN_DELETE_SELF |
+        IN_MOVE_SELF   |
+        IN_ONLYDIR;
+
+    for (const auto& DIR : directories)
+    {
+        if (DIR.empty())
+        {
+            continue;
+        }
+
+        int wd = inotify_add_watch(m_Fd, DIR.c_str(), ce_MASK);
+        if (wd >= 0)
+        {
+            // Watching the same directory twice yields the same descriptor
+            m_Watches[wd] = DIR;
+        }
+    }
+#else
+    (void)directories;
+#endif
+}
+
+void FileWatcher::Clear()
+{
+#if defined(__linux__)
+    for (const auto& [wd, path] : m_Watches)
+    {
+        inotify_rm_watch(m_Fd, wd);
+    }
+    ReadEvents(); // flush whatever was queued for the old watches
+#endif
+    m_Watches.clear();
+    m_Pending.clear();
+    m_PendingIndex.clear();
+    m_bRescan = false;
+}
+
+bool FileWatcher::Poll(std::vector<Change>& out_changes, bool& b_Rescan)
+{
+    out_changes.clear();
+    b_Rescan = false;
+
+    if (m_Fd < 0)
+    {
+        return false;
+    }
+
+    ReadEvents();
+
+    if (m_Pending.empty() && !m_bRescan)
+    {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_LastEvent < ce_COALESCE_QUIET
+        && now - m_FirstEvent < ce_COALESCE_MAX_DELAY)
+    {
+        return false;
+    }
+
+    out_changes.swap(m_Pending);
+    b_Rescan = m_bRescan;
+
+    m_Pending.clear();
+    m_PendingIndex.clear();
+    m_bRescan = false;
+    return true;
+}
+
+void FileWatcher::ReadEvents()
+{
+#if defined(__linux__)
+    if (m_Fd < 0)
+    {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;)
+    {
+        ssize_t len = read(m_Fd, buffer, sizeof(buffer));
+        if (len <= 0)
+        {
+            // EAGAIN: queue drained
+            break;
+        }
+
+        for (char* p = buffer; p < buffer + len; )
+        {
+            const auto* EVENT = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + EVENT->len;
+
+            if (EVENT->mask & IN_Q_OVERFLOW)
+            {
+                if (!m_bRescan && m_Pending.empty())
+                {
+                    m_FirstEvent = std::chrono::steady_clock::now();
+                }
+                m_bRescan = true;
+                m_LastEvent = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            auto it = m_Watches.find(EVENT->wd);
+            if (it == m_Watches.end())
+            {
+                continue;
+            }
+
+            if (EVENT->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                if (!m_bRescan && m_Pending.empty())
+                {
+                    m_FirstEvent = std::chrono::steady_clock::now();
+                }
+                m_bRescan = true;
+                m_LastEvent = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            if (EVENT->len == 0)
+            {
+                continue;
+            }
+
+            e_ChangeType type = e_ChangeType::MODIFIED;
+            if (EVENT->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                type = e_ChangeType::ADDED;
+            }
+            else if (EVENT->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                type = e_ChangeType::REMOVED;
+            }
+
+            AddChange(it->second, EVENT->name, type);
+        }
+    }
+#endif
+}
+
+void FileWatcher::AddChange
+(
+    const fs::path& directory,
+    const std::string& name,
+    e_ChangeType type
+)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (m_Pending.empty() && !m_bRescan)
+    {
+        m_FirstEvent = now;
+    }
+    m_LastEvent = now;
+
+    if (m_bRescan)
+    {
+        // Everything gets re-read anyway
+        return;
+    }
+
+    std::string key = directory.string();
+    key += '/';
+    key += name;
+
+    auto it = m_PendingIndex.find(key);
+    if (it != m_PendingIndex.end())
+    {
+        // Collapse into the latest state, but a fresh entry that is then
+        // written to is still an addition
+        Change& change = m_Pending[it->second];
+        if (!(change.type == e_ChangeType::ADDED && type == e_ChangeType::MODIFIED))
+        {
+            change.type = type;
+        }
+        return;
+    }
+
+    if (m_Pending.size() >= ce_MAX_PENDING_CHANGES)
+    {
+        m_Pending.clear();
+        m_PendingIndex.clear();
+        m_bRescan = true;
+        return;
+    }
+
+    m_PendingIndex.emplace(std::move(key), m_Pending.size());
+    m_Pending.push_back({ directory, name, type });
+}
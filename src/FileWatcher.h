@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Watches a small set of directories for changes (inotify on Linux, a no-op
+// elsewhere). Raw events are coalesced per entry and only handed out once
+// the directory has been quiet for a moment, so a burst such as
+// `git checkout` or `make clean` turns into a single batch.
+class FileWatcher
+{
+public:
+    enum class e_ChangeType { ADDED, REMOVED, MODIFIED };
+
+    struct Change
+    {
+        fs::path directory;
+        std::string name;
+        e_ChangeType type;
+    };
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Function to replace the set of watched directories
+    void Watch(const std::vector<fs::path>& directories);
+
+    // Function to stop watching everything
+    void Clear();
+
+    // Function to collect a coalesced batch of changes. Returns true when a
+    // batch is ready. b_Rescan is set when events were lost (queue overflow,
+    // watched directory removed) and the caller should re-read from scratch.
+    bool Poll(std::vector<Change>& out_changes, bool& b_Rescan);
+
+    bool IsAvailable() const { return m_Fd >= 0; }
+
+private:
+    void ReadEvents();
+    void AddChange(const fs::path& directory, const std::string& name, e_ChangeType type);
+
+    int m_Fd;
+    std::unordered_map<int, fs::path> m_Watches;
+
+    // Pending batch, one slot per (directory, name)
+    std::vector<Change> m_Pending;
+    std::unordered_map<std::string, size_t> m_PendingIndex;
+    bool m_bRescan;
+    std::chrono::steady_clock::time_point m_FirstEvent;
+    std::chrono::steady_clock::time_point m_LastEvent;
+};
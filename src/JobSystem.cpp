@@ -0,0 +1,74 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned thread_count)
+{
+    if (thread_count == 0)
+    {
+        // Leave a core for the render thread
+        unsigned cores = std::thread::hardware_concurrency();
+        thread_count = std::max(1u, cores > 1 ? cores - 1 : 1u);
+    }
+
+    m_Workers.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i)
+    {
+        m_Workers.emplace_back(&JobSystem::WorkerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStopping = true;
+        for (auto& JOB : m_Queue)
+        {
+            JOB.handle->Cancel();
+        }
+        m_Queue.clear();
+    }
+    m_WakeUp.notify_all();
+
+    for (auto& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+std::shared_ptr<JobHandle> JobSystem::Submit(Work work)
+{
+    auto handle = std::make_shared<JobHandle>();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.push_back({ std::move(work), handle });
+    }
+    m_WakeUp.notify_one();
+    return handle;
+}
+
+void JobSystem::WorkerLoop()
+{
+    for (;;)
+    {
+        QueuedJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeUp.wait(lock, [this] { return m_bStopping || !m_Queue.empty(); });
+            if (m_bStopping)
+            {
+                return;
+            }
+            job = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+
+        // A job cancelled while still queued never starts
+        if (!job.handle->IsCancelled())
+        {
+            job.work(*job.handle);
+        }
+        job.handle->m_bDone.store(true, std::memory_order_release);
+    }
+}
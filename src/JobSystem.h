@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared between a job and whoever submitted it. The submitter polls
+// IsDone() once per frame and may Cancel() at any time; the job checks
+// IsCancelled() between chunks of work and reports SetProgress().
+// Everything the job wrote before finishing is visible once IsDone()
+// returns true.
+class JobHandle
+{
+public:
+    void Cancel() { m_bCancelled.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return m_bCancelled.load(std::memory_order_relaxed); }
+
+    void SetProgress(float progress) { m_Progress.store(progress, std::memory_order_relaxed); }
+    float GetProgress() const { return m_Progress.load(std::memory_order_relaxed); }
+
+    bool IsDone() const { return m_bDone.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<bool> m_bCancelled = false;
+    std::atomic<float> m_Progress = 0.0f;
+    std::atomic<bool> m_bDone = false;
+};
+
+// Fixed pool of worker threads running jobs in submission order. Jobs must
+// only touch state they own (capture results through a shared_ptr), since
+// a cancelled job is simply left to finish on its own.
+class JobSystem
+{
+public:
+    using Work = std::function<void(JobHandle& job)>;
+
+    // Function to start the workers, 0 picks one less than the core count
+    explicit JobSystem(unsigned thread_count = 0);
+
+    // Cancels queued jobs and waits for running ones
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Function to queue a job
+    std::shared_ptr<JobHandle> Submit(Work work);
+
+private:
+    struct QueuedJob
+    {
+        Work work;
+        std::shared_ptr<JobHandle> handle;
+    };
+
+    void WorkerLoop();
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::deque<QueuedJob> m_Queue;
+    bool m_bStopping = false;
+    std::vector<std::thread> m_Workers;
+};
@@ -0,0 +1,207 @@
+#include "LargeFileViewer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// One index entry per this many lines
+constexpr size_t ce_LINES_PER_CHECKPOINT = 256;
+
+// Indexing work per frame, the scan stops at whichever limit comes first
+constexpr size_t ce_INDEX_BYTES_PER_FRAME = 64 * 1024 * 1024;
+constexpr auto ce_INDEX_TIME_PER_FRAME = std::chrono::milliseconds(4);
+
+// Longer lines are cut for display, ImGui would lay out every glyph
+constexpr size_t ce_MAX_DISPLAY_LINE = 4096;
+
+bool LargeFileViewer::Open(const fs::path& path, std::string& error)
+{
+    Close();
+
+    if (!m_File.Open(path, error))
+    {
+        return false;
+    }
+
+    m_Path = path;
+    m_Size = m_File.Size();
+    m_Checkpoints.push_back(0);
+    m_LineCount = 1;
+    return true;
+}
+
+void LargeFileViewer::Close()
+{
+    m_File.Close();
+    m_Path.clear();
+    m_Size = 0;
+    m_Checkpoints.clear();
+    m_IndexedBytes = 0;
+    m_LineCount = 0;
+    m_CursorLine = 0;
+    m_CursorOffset = 0;
+}
+
+void LargeFileViewer::Update()
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+
+    // Pages past the end of a file truncated underneath (by log rotation
+    // with copytruncate, say) fault when touched, so nothing beyond its
+    // current length is read this frame
+    size_t readable = m_File.ReadableSize();
+    if (readable < m_Size)
+    {
+        Truncate(readable);
+    }
+
+    if (!IsIndexing())
+    {
+        return;
+    }
+
+    const char* data = m_File.Data();
+    size_t size = m_Size;
+    size_t end = std::min(size, m_IndexedBytes + ce_INDEX_BYTES_PER_FRAME);
+    auto deadline = std::chrono::steady_clock::now() + ce_INDEX_TIME_PER_FRAME;
+
+    size_t pos = m_IndexedBytes;
+    while (pos < end)
+    {
+        // Check the clock once per 1 MB slice, not per line
+        size_t slice_end = std::min(end, pos + 1024 * 1024);
+        while (pos < slice_end)
+        {
+            const void* found = std::memchr(data + pos, '\n', slice_end - pos);
+            if (found == nullptr)
+            {
+                pos = slice_end;
+                break;
+            }
+
+            pos = static_cast<size_t>(static_cast<const char*>(found) - data) + 1;
+            if (m_LineCount % ce_LINES_PER_CHECKPOINT == 0)
+            {
+                m_Checkpoints.push_back(pos);
+            }
+            ++m_LineCount;
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+    }
+
+    m_IndexedBytes = pos;
+
+    // A trailing newline does not start another line
+    if (m_IndexedBytes == size && size > 0 && data[size - 1] == '\n')
+    {
+        --m_LineCount;
+    }
+}
+
+void LargeFileViewer::Truncate(size_t size)
+{
+    // A checkpoint at the new end is dropped too, so indexing starts again
+    // and decides whether a trailing newline ends the last line
+    m_Size = size;
+    while (m_Checkpoints.size() > 1 && m_Checkpoints.back() >= size)
+    {
+        m_Checkpoints.pop_back();
+    }
+
+    m_IndexedBytes = m_Checkpoints.back();
+    m_LineCount = (m_Checkpoints.size() - 1) * ce_LINES_PER_CHECKPOINT + 1;
+    m_CursorLine = 0;
+    m_CursorOffset = 0;
+}
+
+std::string_view LargeFileViewer::GetLine(size_t index)
+{
+    const char* data = m_File.Data();
+    size_t size = m_Size;
+
+    // Continue from the previous lookup when it is close behind, otherwise
+    // restart from the checkpoint
+    size_t line = index - index % ce_LINES_PER_CHECKPOINT;
+    size_t offset = m_Checkpoints[line / ce_LINES_PER_CHECKPOINT];
+    if (m_CursorLine <= index && m_CursorLine > line)
+    {
+        line = m_CursorLine;
+        offset = m_CursorOffset;
+    }
+
+    for (; line < index && offset < size; ++line)
+    {
+        const void* found = std::memchr(data + offset, '\n', size - offset);
+        offset = (found == nullptr) ? size : static_cast<size_t>(static_cast<const char*>(found) - data) + 1;
+    }
+
+    const void* found = std::memchr(data + offset, '\n', size - offset);
+    size_t end = (found == nullptr) ? size : static_cast<size_t>(static_cast<const char*>(found) - data);
+
+    m_CursorLine = index + 1;
+    m_CursorOffset = std::min(size, end + 1);
+
+    if (end > offset && data[end - 1] == '\r')
+    {
+        --end;
+    }
+    return { data + offset, end - offset };
+}
+
+void LargeFileViewer::Render(const char* id, const ImVec2& size)
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+
+    if (IsIndexing())
+    {
+        float progress = static_cast<float>(m_IndexedBytes) / static_cast<float>(m_Size);
+        ImGui::ProgressBar(progress, ImVec2(-1.0f, 0.0f), "Indexing lines...");
+    }
+    ImGui::TextDisabled
+    (
+        "Read-only large file view, %zu lines%s",
+        m_LineCount,
+        IsIndexing() ? " so far" : ""
+    );
+
+    ImGui::BeginChild(id, size, false, ImGuiWindowFlags_HorizontalScrollbar);
+
+    // Only complete lines are shown while the index is still growing
+    size_t line_count = IsIndexing() ? m_LineCount - 1 : m_LineCount;
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(std::min<size_t>(line_count, INT32_MAX)));
+    while (clipper.Step())
+    {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+            std::string_view line = GetLine(static_cast<size_t>(i));
+
+            ImGui::TextDisabled("%8d ", i + 1);
+            ImGui::SameLine(0.0f, 0.0f);
+
+            if (line.size() > ce_MAX_DISPLAY_LINE)
+            {
+                ImGui::TextUnformatted(line.data(), line.data() + ce_MAX_DISPLAY_LINE);
+                ImGui::SameLine(0.0f, 0.0f);
+                ImGui::TextDisabled(" ... (%zu more bytes)", line.size() - ce_MAX_DISPLAY_LINE);
+            }
+            else
+            {
+                ImGui::TextUnformatted(line.data(), line.data() + line.size());
+            }
+        }
+    }
+
+    ImGui::EndChild();
+}
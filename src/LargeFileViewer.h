@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <imgui.h>
+
+#include "MappedFile.h"
+
+namespace fs = std::filesystem;
+
+// Read-only, paged view of a file too large for the editor. The file is
+// memory-mapped and a sparse line index (the byte offset of every
+// ce_LINES_PER_CHECKPOINT-th line) is built a slice at a time, so memory
+// stays a few bytes per hundred lines and only the pages of the rows on
+// screen are touched while scrolling. The file's length is checked every
+// frame, so one truncated underneath is shown cut short instead of
+// faulting on the pages it lost.
+class LargeFileViewer
+{
+public:
+    LargeFileViewer() = default;
+
+    LargeFileViewer(const LargeFileViewer&) = delete;
+    LargeFileViewer& operator=(const LargeFileViewer&) = delete;
+
+    // Function to map a file and start indexing it
+    bool Open(const fs::path& path, std::string& error);
+
+    // Function to unmap the file and drop the index
+    void Close();
+
+    // Function to index the next slice of the file, call once per frame
+    // before Render()
+    void Update();
+
+    // Function to draw the visible lines
+    void Render(const char* id, const ImVec2& size);
+
+    bool IsOpen() const { return m_File.IsOpen(); }
+    bool IsIndexing() const { return IsOpen() && m_IndexedBytes < m_Size; }
+    const fs::path& GetPath() const { return m_Path; }
+    size_t GetLineCount() const { return m_LineCount; }
+    size_t GetFileSize() const { return m_Size; }
+
+private:
+    // Function to drop whatever the index holds past size and index again
+    // from the last checkpoint before it
+    void Truncate(size_t size);
+
+    // Function to get the text of line index, located from the nearest checkpoint
+    std::string_view GetLine(size_t index);
+
+    MappedFile m_File;
+    fs::path m_Path;
+    size_t m_Size = 0;      // bytes that may be read, the mapped size until the file shrinks
+
+    std::vector<size_t> m_Checkpoints;
+    size_t m_IndexedBytes = 0;
+    size_t m_LineCount = 0;
+
+    // The last line looked up, so walking down the screen is sequential
+    size_t m_CursorLine = 0;
+    size_t m_CursorOffset = 0;
+};
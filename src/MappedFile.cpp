@@ -0,0 +1,239 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <utility>
+
+// Platform headers stay in this file, windows.h clashes with raylib.h
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// What m_File holds while no file is open
+#if defined(_WIN32)
+constexpr void* ce_NO_FILE = nullptr;
+#else
+constexpr int ce_NO_FILE = -1;
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_Data(std::exchange(other.m_Data, nullptr))
+    , m_Size(std::exchange(other.m_Size, 0))
+    , m_bOpen(std::exchange(other.m_bOpen, false))
+    , m_File(std::exchange(other.m_File, ce_NO_FILE))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+        m_bOpen = std::exchange(other.m_bOpen, false);
+        m_File = std::exchange(other.m_File, ce_NO_FILE);
+    }
+    return *this;
+}
+
+#if defined(_WIN32)
+
+static std::string LastErrorMessage()
+{
+    char buffer[256] = {};
+    FormatMessageA
+    (
+        FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        nullptr,
+        GetLastError(),
+        0,
+        buffer,
+        sizeof(buffer),
+        nullptr
+    );
+    return buffer;
+}
+
+bool MappedFile::Open(const fs::path& path, std::string& error)
+{
+    Close();
+
+    HANDLE file = CreateFileW
+    (
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error = LastErrorMessage();
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size))
+    {
+        error = LastErrorMessage();
+        CloseHandle(file);
+        return false;
+    }
+
+    if (size.QuadPart == 0)
+    {
+        // A zero-length mapping is not allowed
+        m_File = file;
+        m_bOpen = true;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        error = LastErrorMessage();
+        CloseHandle(file);
+        return false;
+    }
+
+    // The view keeps the mapping object alive
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr)
+    {
+        error = LastErrorMessage();
+        CloseHandle(file);
+        return false;
+    }
+
+    m_File = file;
+    m_Data = static_cast<const char*>(view);
+    m_Size = static_cast<size_t>(size.QuadPart);
+    m_bOpen = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_File != nullptr)
+    {
+        CloseHandle(static_cast<HANDLE>(m_File));
+    }
+    m_File = nullptr;
+    m_Data = nullptr;
+    m_Size = 0;
+    m_bOpen = false;
+}
+
+size_t MappedFile::ReadableSize() const
+{
+    LARGE_INTEGER size = {};
+    if (m_File == nullptr || !GetFileSizeEx(static_cast<HANDLE>(m_File), &size))
+    {
+        return m_Size;
+    }
+    return std::min(m_Size, static_cast<size_t>(size.QuadPart));
+}
+
+#else
+
+bool MappedFile::Open(const fs::path& path, std::string& error)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = std::strerror(errno);
+        return false;
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0)
+    {
+        error = std::strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    if (!S_ISREG(info.st_mode))
+    {
+        error = "Not a regular file";
+        close(fd);
+        return false;
+    }
+
+    if (info.st_size == 0)
+    {
+        // mmap rejects a zero length
+        m_File = fd;
+        m_bOpen = true;
+        return true;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        error = std::strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // Parsed front to back, let the kernel read ahead aggressively
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    m_File = fd;
+    m_Data = static_cast<const char*>(data);
+    m_Size = size;
+    m_bOpen = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        munmap(const_cast<char*>(m_Data), m_Size);
+    }
+    if (m_File >= 0)
+    {
+        close(m_File);
+    }
+    m_File = -1;
+    m_Data = nullptr;
+    m_Size = 0;
+    m_bOpen = false;
+}
+
+size_t MappedFile::ReadableSize() const
+{
+    struct stat info = {};
+    if (m_File < 0 || fstat(m_File, &info) != 0)
+    {
+        return m_Size;
+    }
+    return std::min(m_Size, static_cast<size_t>(info.st_size));
+}
+
+#endif
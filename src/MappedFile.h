@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+// Read-only memory mapping of a whole file (mmap on POSIX, a file mapping
+// on Windows). The pages are only read in as they are touched, so a
+// consumer can parse straight out of the mapping without an intermediate
+// buffer. The mapping must outlive every view handed out from it, and it
+// should be held briefly: if another process truncates the file, touching
+// the lost pages faults. One that is kept open reads no further than
+// ReadableSize(), asked again before each batch of reads.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Function to map a file, replacing any previous mapping. An empty file
+    // opens successfully with no data.
+    bool Open(const fs::path& path, std::string& error);
+
+    // Function to unmap the file
+    void Close();
+
+    bool IsOpen() const { return m_bOpen; }
+    const char* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+    std::string_view View() const { return { m_Data, m_Size }; }
+
+    // Function to get how much of the mapping is still backed by the file,
+    // less than Size() once the file has been truncated
+    size_t ReadableSize() const;
+
+private:
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+    bool m_bOpen = false;
+
+    // Kept open to look up the file's current length
+#if defined(_WIN32)
+    void* m_File = nullptr;
+#else
+    int m_File = -1;
+#endif
+};